@@ -0,0 +1,141 @@
+#include "asset_pool.h"
+#include "profiler.h"
+#include <algorithm>
+
+
+asset_pool::asset_pool(size_t n_workers) {
+    if (!n_workers)
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+
+    workers_.reserve(n_workers);
+    for (size_t i = 0; i < n_workers; ++i)
+        workers_.emplace_back(&asset_pool::work, this);
+}
+
+
+asset_pool::~asset_pool() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        stopping_ = true;
+    }
+    job_ready_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+
+void asset_pool::submit(job j) {
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        jobs_.push_back(std::move(j));
+        ++pending_;
+    }
+    job_ready_.notify_one();
+}
+
+
+void asset_pool::finish() {
+    std::exception_ptr first_error;
+
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    while (pending_) {
+        result_ready_.wait(lock, [this]() { return !results_.empty(); });
+
+        result r = std::move(results_.front());
+        results_.pop_front();
+        --pending_;
+
+        lock.unlock();
+
+        if (r.error) {
+            if (!first_error)
+                first_error = r.error;
+        } else if (r.next && !first_error) {
+            try {
+                r.next();
+            } catch (...) {
+                first_error = std::current_exception();
+            }
+        }
+
+        lock.lock();
+    }
+
+    if (first_error)
+        std::rethrow_exception(first_error);
+}
+
+
+void asset_pool::poll() {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    while (!results_.empty()) {
+        result r = std::move(results_.front());
+        results_.pop_front();
+        --pending_;
+
+        lock.unlock();
+
+        if (r.error)
+            std::rethrow_exception(r.error);
+        if (r.next)
+            r.next();
+
+        lock.lock();
+    }
+}
+
+
+bool asset_pool::wait_one() {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    if (!pending_)
+        return false;
+
+    result_ready_.wait(lock, [this]() { return !results_.empty(); });
+
+    result r = std::move(results_.front());
+    results_.pop_front();
+    --pending_;
+
+    lock.unlock();
+
+    if (r.error)
+        std::rethrow_exception(r.error);
+    if (r.next)
+        r.next();
+
+    return true;
+}
+
+
+void asset_pool::work() {
+    profile_thread_name("asset worker");
+
+    for (;;) {
+        job j;
+        {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            job_ready_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+
+            if (jobs_.empty())
+                return;
+
+            j = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        result r;
+        try {
+            profile_scope scope{ "asset job" };
+            r.next = j();
+        } catch (...) {
+            r.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            results_.push_back(std::move(r));
+        }
+        result_ready_.notify_one();
+    }
+}
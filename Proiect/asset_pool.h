@@ -0,0 +1,63 @@
+#pragma once
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/* Worker threads for the CPU side of asset loading.
+ *
+ * A job runs on a worker and returns a continuation, which finish(), poll() or wait_one() run
+ * on the calling thread, the one owning the GL context, in the order the jobs complete.
+ * Decoding and importing overlap each other and the uploads of earlier assets. */
+class asset_pool {
+public:
+    using continuation = std::function<void()>;
+    using job = std::function<continuation()>;
+
+    /* One worker per hardware thread by default */
+    explicit asset_pool(size_t n_workers = 0);
+    ~asset_pool();
+
+    asset_pool(const asset_pool &other) = delete;
+    asset_pool &operator=(const asset_pool &other) = delete;
+
+    void submit(job j);
+
+    /* Runs continuations until every submitted job is done. The first exception
+     * thrown by a job or a continuation is rethrown once the rest have finished. */
+    void finish();
+
+    /* Runs the continuations of the jobs done so far without waiting for the others,
+     * exceptions are rethrown right away */
+    void poll();
+
+    /* Runs the continuation of the next job to complete, waiting for it if none has yet.
+     * Exceptions are rethrown right away. False, without waiting, when no job is pending. */
+    bool wait_one();
+
+private:
+    struct result {
+        continuation next;
+        std::exception_ptr error;
+    };
+
+    void work();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable job_ready_;
+    std::condition_variable result_ready_;
+
+    std::deque<job> jobs_;
+    std::deque<result> results_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+};
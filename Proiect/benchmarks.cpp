@@ -0,0 +1,679 @@
+#include "benchmarks.h"
+#include "transform.h"
+#include "transform_batch.h"
+#include "frustum_cull.h"
+#include "loader.h"
+#include "gltf.h"
+#include "mesh.h"
+#include "obj_parser.h"
+#include "scene_import.h"
+#include "image.h"
+#include "euler_angle.h"
+#include "light.h"
+#include "light_buffer.h"
+#include "shader.h"
+#include "program_variants.h"
+#include "wrappers.h"
+#include <spdlog/spdlog.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/* Written to after every run so the compiler can't drop the work being timed */
+static volatile float sink;
+
+
+/* Nanoseconds per item over the repetitions of one case */
+struct benchmark_result {
+    std::string name;
+    size_t items;
+    int repetitions;
+    double median;
+    double min;
+    double max;
+};
+
+static std::vector<benchmark_result> results;
+
+/* Only cases whose name contains it run, see run_benchmarks */
+static std::string name_filter;
+
+
+static bool selected(const std::string &name) {
+    return name_filter.empty() || name.find(name_filter) != std::string::npos;
+}
+
+
+/* Median of the repetitions, in nanoseconds per item. setup runs before every repetition
+ * without being timed. Cases the filter leaves out aren't run and give 0. */
+template <typename F, typename S>
+static double measure(const std::string &name, size_t items, int repetitions, F &&body, S &&setup) {
+    if (!selected(name))
+        return 0.0;
+
+    std::vector<double> samples;
+
+    for (int r = 0; r < repetitions; ++r) {
+        setup();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        samples.push_back(elapsed.count() / items);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    results.push_back({ name, items, repetitions, samples[samples.size() / 2], samples.front(), samples.back() });
+
+    return samples[samples.size() / 2];
+}
+
+
+template <typename F>
+static double measure(const std::string &name, size_t items, int repetitions, F &&body) {
+    return measure(name, items, repetitions, std::forward<F>(body), []() {});
+}
+
+
+static void benchmark_transforms(size_t count) {
+    std::mt19937 rng{ 42 };
+    std::uniform_real_distribution<float> position{ -50.0f, 50.0f };
+    std::uniform_real_distribution<float> angle{ -180.0f, 180.0f };
+    std::uniform_real_distribution<float> scale{ 0.1f, 4.0f };
+
+    std::vector<transform> transforms;
+    transforms.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        transforms.emplace_back(glm::vec3{ position(rng), position(rng), position(rng) },
+                                glm::vec3{ angle(rng), angle(rng), angle(rng) },
+                                glm::vec3{ scale(rng), scale(rng), scale(rng) });
+
+    glm::mat4 view_proj = glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 100.0f)
+        * glm::lookAt(glm::vec3{ 4.0f, 54.0f, -48.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+
+    std::vector<glm::mat4> model(count);
+    std::vector<glm::mat3> normal(count);
+    std::vector<glm::mat4> mvp(count);
+
+    const std::string suffix = "/" + std::to_string(count);
+
+    /* to_model and the inverse transpose for the normals, the way the main loop did them per object */
+    double per_object = measure("transform/to_model" + suffix, count, 31, [&]() {
+        for (size_t i = 0; i < count; ++i) {
+            model[i] = transforms[i].to_model();
+            normal[i] = glm::transpose(glm::inverse(glm::mat3(model[i])));
+            mvp[i] = view_proj * model[i];
+        }
+
+        sink = mvp[count - 1][3][3] + normal[count - 1][2][2];
+    });
+
+    for (float static_share : { 0.0f, 0.9f }) {
+        transform_batch batch;
+        size_t n_static = (size_t)(count * static_share);
+        for (size_t i = 0; i < count; ++i)
+            batch.add(transforms[i], i < n_static);
+
+        std::string batch_name = "transform_batch" + suffix + "/static_" + std::to_string((int)(static_share * 100.0f));
+
+        double batched = measure(batch_name, count, 31, [&]() {
+            batch.update();
+            batch.compute_mvp(view_proj);
+
+            sink = batch.mvp((uint32_t)count - 1)[3][3] + batch.normal((uint32_t)count - 1)[2][2];
+        });
+
+        if (per_object > 0.0 && batched > 0.0)
+            spdlog::info("transforms x{} ({:.0f}% static): per object {:.1f} ns, batched {:.1f} ns, {:.1f}x",
+                         count, static_share * 100.0f, per_object, batched, per_object / batched);
+    }
+}
+
+
+/* Spheres spread around a camera like the stress scenes, about a fifth inside the frustum.
+ * The unsuffixed case is the path cull() picks, the others are there to compare it with. */
+static void benchmark_frustum_cull(size_t count) {
+    std::mt19937 rng{ 42 };
+    std::uniform_real_distribution<float> position{ -60.0f, 60.0f };
+    std::uniform_real_distribution<float> radius{ 0.5f, 3.0f };
+
+    cull_set spheres;
+    for (size_t i = 0; i < count; ++i) {
+        float x = position(rng);
+        float y = position(rng);
+        float z = position(rng);
+        spheres.add(glm::vec3{ x, y, z }, radius(rng));
+    }
+
+    frustum f = extract_frustum(glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 100.0f)
+        * glm::lookAt(glm::vec3{ 0.0f, 0.0f, -50.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }));
+
+    std::vector<uint32_t> visible;
+    visible.reserve(count);
+
+    const std::string suffix = "/" + std::to_string(count);
+
+    auto run = [&](const std::string &name, cull_path path) {
+        return measure(name + suffix, count, 101, [&]() {
+            spheres.cull(f, visible, path);
+
+            sink = (float)visible.size();
+        });
+    };
+
+    double best = run("frustum_cull", cull_path::best);
+    double sse = run("frustum_cull/sse", cull_path::sse);
+    double scalar = run("frustum_cull/scalar", cull_path::scalar);
+
+    if (best > 0.0 && sse > 0.0 && scalar > 0.0)
+        spdlog::info("frustum cull x{} ({}): {:.2f} ns, sse {:.2f} ns, scalar {:.2f} ns, {:.1f}x over scalar",
+                     count, cull_set::avx_supported() ? "avx" : "sse", best, sse, scalar, scalar / best);
+}
+
+
+/* Rolling terrain of about the given triangle count with positions, uvs and normals,
+ * printed with six decimals like the exporters do. With more than one object the rows
+ * of faces are split into that many bands, each an object of its own, which Assimp
+ * imports as separate meshes. */
+static std::filesystem::path write_synthetic_obj(const char *name, size_t triangles, size_t objects = 1) {
+    auto path = std::filesystem::temp_directory_path() / name;
+
+    size_t side = (size_t)std::ceil(std::sqrt(triangles / 2.0)) + 1;
+
+    FILE *file = std::fopen(path.string().c_str(), "w");
+    if (!file)
+        return {};
+
+    for (size_t y = 0; y < side; ++y) {
+        for (size_t x = 0; x < side; ++x) {
+            float u = (float)x / (side - 1);
+            float v = (float)y / (side - 1);
+            float height = 0.05f * std::sin(40.0f * u) * std::cos(30.0f * v);
+
+            glm::vec3 normal = glm::normalize(glm::vec3{ -2.0f * std::cos(40.0f * u) * std::cos(30.0f * v), 1.0f,
+                                                         1.5f * std::sin(40.0f * u) * std::sin(30.0f * v) });
+
+            std::fprintf(file, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                         u * 10.0f, height, v * 10.0f, u, v, normal.x, normal.y, normal.z);
+        }
+    }
+
+    size_t band = (side - 1 + objects - 1) / objects;
+
+    for (size_t y = 0; y + 1 < side; ++y) {
+        if (objects > 1 && y % band == 0)
+            std::fprintf(file, "o part_%zu\n", y / band);
+
+        for (size_t x = 0; x + 1 < side; ++x) {
+            size_t a = y * side + x + 1;
+            size_t b = a + 1;
+            size_t c = a + side + 1;
+            size_t d = a + side;
+
+            std::fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                         a, a, a, b, b, b, c, c, c, a, a, a, c, c, c, d, d, d);
+        }
+    }
+
+    std::fclose(file);
+
+    return path;
+}
+
+
+/* The same terrain as a .glb, one primitive whose positions, normals, uvs and 32 bit
+ * indices each have a buffer view of their own */
+static std::filesystem::path write_synthetic_glb(size_t triangles) {
+    auto path = std::filesystem::temp_directory_path() / "synthetic.glb";
+
+    size_t side = (size_t)std::ceil(std::sqrt(triangles / 2.0)) + 1;
+    size_t vertex_count = side * side;
+    size_t index_count = (side - 1) * (side - 1) * 6;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> indices;
+    positions.reserve(vertex_count);
+    normals.reserve(vertex_count);
+    uvs.reserve(vertex_count);
+    indices.reserve(index_count);
+
+    for (size_t y = 0; y < side; ++y) {
+        for (size_t x = 0; x < side; ++x) {
+            float u = (float)x / (side - 1);
+            float v = (float)y / (side - 1);
+            float height = 0.05f * std::sin(40.0f * u) * std::cos(30.0f * v);
+
+            positions.emplace_back(u * 10.0f, height, v * 10.0f);
+            normals.push_back(glm::normalize(glm::vec3{ -2.0f * std::cos(40.0f * u) * std::cos(30.0f * v), 1.0f,
+                                                        1.5f * std::sin(40.0f * u) * std::sin(30.0f * v) }));
+            uvs.emplace_back(u, v);
+        }
+    }
+
+    for (size_t y = 0; y + 1 < side; ++y) {
+        for (size_t x = 0; x + 1 < side; ++x) {
+            uint32_t a = (uint32_t)(y * side + x);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)side + 1;
+            uint32_t d = a + (uint32_t)side;
+
+            for (uint32_t i : { a, c, b, a, d, c })
+                indices.push_back(i);
+        }
+    }
+
+    /* Every stream is a multiple of 4 bytes, so the views stay aligned back to back */
+    const size_t sizes[] = { positions.size() * sizeof(glm::vec3), normals.size() * sizeof(glm::vec3),
+                             uvs.size() * sizeof(glm::vec2), indices.size() * sizeof(uint32_t) };
+    const void *streams[] = { positions.data(), normals.data(), uvs.data(), indices.data() };
+
+    size_t bin_size = sizes[0] + sizes[1] + sizes[2] + sizes[3];
+
+    std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(bin_size) + "}],\"bufferViews\":[";
+    for (size_t i = 0, offset = 0; i < 4; offset += sizes[i], ++i)
+        json += (i ? "," : "") + std::string{ "{\"buffer\":0,\"byteOffset\":" } + std::to_string(offset)
+            + ",\"byteLength\":" + std::to_string(sizes[i]) + "}";
+
+    json += "],\"accessors\":["
+        "{\"bufferView\":0,\"componentType\":5126,\"type\":\"VEC3\",\"count\":" + std::to_string(vertex_count) + "},"
+        "{\"bufferView\":1,\"componentType\":5126,\"type\":\"VEC3\",\"count\":" + std::to_string(vertex_count) + "},"
+        "{\"bufferView\":2,\"componentType\":5126,\"type\":\"VEC2\",\"count\":" + std::to_string(vertex_count) + "},"
+        "{\"bufferView\":3,\"componentType\":5125,\"type\":\"SCALAR\",\"count\":" + std::to_string(index_count) + "}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+        "\"nodes\":[{\"mesh\":0}],\"scenes\":[{\"nodes\":[0]}]}";
+
+    /* The JSON chunk is padded to 4 bytes with spaces, as the spec asks */
+    json.resize((json.size() + 3) & ~(size_t)3, ' ');
+
+    FILE *file = std::fopen(path.string().c_str(), "wb");
+    if (!file)
+        return {};
+
+    auto write_u32 = [&](size_t value) {
+        uint32_t v = (uint32_t)value;
+        std::fwrite(&v, sizeof(v), 1, file);
+    };
+
+    write_u32(0x46546C67);
+    write_u32(2);
+    write_u32(12 + 8 + json.size() + 8 + bin_size);
+
+    write_u32(json.size());
+    write_u32(0x4E4F534A);
+    std::fwrite(json.data(), 1, json.size(), file);
+
+    write_u32(bin_size);
+    write_u32(0x004E4942);
+    for (size_t i = 0; i < 4; ++i)
+        std::fwrite(streams[i], 1, sizes[i], file);
+
+    bool written = !std::ferror(file);
+    std::fclose(file);
+
+    return written ? path : std::filesystem::path{};
+}
+
+
+/* Removes the mesh cache entries of a source, so the next load_asset imports it */
+static void forget_cache(const std::filesystem::path &source) {
+    std::string prefix = source.filename().string() + ".";
+
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator{ "cache", ec }) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0)
+            std::filesystem::remove(entry.path(), ec);
+    }
+}
+
+
+static void benchmark_obj_import(const std::string &path, int repetitions) {
+    size_t triangles = 0;
+
+    /* measure() gives nanoseconds per item, with one item that is the whole import */
+    std::string name = std::filesystem::path{ path }.filename().string();
+
+    double assimp = measure("import_assimp/" + name, 1, repetitions, [&]() {
+        auto mesh = loader::import_assimp(path.c_str());
+
+        triangles = mesh.second.size() / 3;
+        sink = mesh.first.back().position.x;
+    });
+
+    double parser = measure("import_obj/" + name, 1, repetitions, [&]() {
+        auto mesh = loader::import_obj(path.c_str());
+
+        sink = mesh.first.back().position.x;
+    });
+
+    if (assimp > 0.0 && parser > 0.0)
+        spdlog::info("obj import of {} ({} triangles): assimp {:.2f} ms, parser {:.2f} ms, {:.1f}x",
+                     path, triangles, assimp * 1e-6, parser * 1e-6, assimp / parser);
+}
+
+
+/* Cold loads find no cache entry and import, warm ones map the entry the cold ones wrote */
+static void benchmark_load_asset(const std::string &path, int repetitions) {
+    if (!std::filesystem::exists(path))
+        return;
+
+    measure("load_asset/cold/" + path, 1, repetitions, [&]() {
+        loader::mesh_data mesh = loader::load_asset(path.c_str());
+
+        sink = mesh.vertex_data()[0].position.x;
+    }, [&]() { forget_cache(path); });
+
+    measure("load_asset/warm/" + path, 1, repetitions, [&]() {
+        loader::mesh_data mesh = loader::load_asset(path.c_str());
+
+        sink = mesh.vertex_data()[0].position.x;
+    });
+}
+
+
+/* A file of several meshes: load_scene keeps them apart, welding and optimizing each,
+ * against import_assimp merging them raw */
+static void benchmark_scene_import(size_t triangles, size_t objects, int repetitions) {
+    if (!selected("load_scene/synthetic_scene.obj") && !selected("import_assimp/synthetic_scene.obj"))
+        return;
+
+    auto path = write_synthetic_obj("synthetic_scene.obj", triangles, objects);
+    if (path.empty()) {
+        spdlog::error("Failed to write the synthetic scene");
+        return;
+    }
+
+    const std::string file = path.string();
+    size_t submeshes = 0;
+
+    measure("load_scene/synthetic_scene.obj", 1, repetitions, [&]() {
+        loader::scene_data scene = loader::load_scene(file.c_str());
+
+        submeshes = scene.submeshes.size();
+        sink = scene.vertices.back().position.x;
+    });
+
+    measure("import_assimp/synthetic_scene.obj", 1, repetitions, [&]() {
+        auto mesh = loader::import_assimp(file.c_str());
+
+        sink = mesh.first.back().position.x;
+    });
+
+    if (submeshes)
+        spdlog::info("Synthetic scene of {} triangles imported as {} submeshes", triangles, submeshes);
+
+    std::filesystem::remove(path);
+}
+
+
+static void benchmark_decode_image(const std::string &path, int repetitions) {
+    if (!std::filesystem::exists(path))
+        return;
+
+    measure("decode_image/" + path, 1, repetitions, [&]() {
+        image_data image = decode_image(path, false);
+
+        sink = image.pixels.get()[0];
+    });
+}
+
+
+/* The camera update of process_mouse_movement, over many angles so the branches of normalize vary */
+static void benchmark_euler_angles(size_t count) {
+    std::mt19937 rng{ 7 };
+    std::uniform_real_distribution<float> pitch{ -120.0f, 120.0f };
+    std::uniform_real_distribution<float> yaw{ -600.0f, 600.0f };
+
+    std::vector<euler_angle> source;
+    source.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        source.emplace_back(pitch(rng), yaw(rng), 0.0f);
+
+    /* normalize changes the angles, every repetition starts from the same ones */
+    std::vector<euler_angle> angles;
+
+    measure("euler_angle/normalize+to_vector/" + std::to_string(count), count, 31, [&]() {
+        glm::vec3 sum{ 0.0f };
+        for (euler_angle &angle : angles) {
+            angle.normalize();
+            sum += angle.to_vector();
+        }
+
+        sink = sum.x + sum.y + sum.z;
+    }, [&]() { angles = source; });
+}
+
+
+/* The uniform names the light constructor built for its get_location calls, six per light,
+ * before light_buffer replaced the per light uniforms */
+static void benchmark_light_names(size_t count) {
+    static const char *members[] = { ".position", ".ambient", ".constant", ".linear", ".quadratic", ".color" };
+
+    measure("light_names/" + std::to_string(count), count, 31, [&]() {
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i) {
+            std::string name = "u_light[" + std::to_string(i) + "]";
+            for (const char *member : members)
+                length += (name + member).size();
+        }
+
+        sink = (float)length;
+    });
+}
+
+
+/* A .glb from file to GPU buffers: drawn in place from the mapping, against load_asset's
+ * import, weld, optimize and LODs before the packed upload the viewer makes. glFinish
+ * waits for the uploads to land in both. */
+static void benchmark_load_glb(size_t triangles, int repetitions) {
+    if (!selected("load_glb/in_place") && !selected("load_glb/load_asset"))
+        return;
+
+    auto path = write_synthetic_glb(triangles);
+    if (path.empty()) {
+        spdlog::error("Failed to write the synthetic glb");
+        return;
+    }
+
+    const std::string file = path.string();
+
+    double in_place = measure("load_glb/in_place/synthetic.glb", 1, repetitions, [&]() {
+        loader::gltf_asset asset{ path };
+
+        std::vector<gpu_mesh> meshes;
+        for (const loader::gltf_primitive &primitive : asset.primitives())
+            meshes.push_back(upload_mesh(primitive));
+
+        glFinish();
+        sink = (float)meshes.back().index_count;
+    });
+
+    double imported = measure("load_glb/load_asset/synthetic.glb", 1, repetitions, [&]() {
+        loader::mesh_data mesh = loader::load_asset(file.c_str());
+        gpu_mesh uploaded = upload_mesh(mesh, vertex_format::packed);
+
+        glFinish();
+        sink = (float)uploaded.index_count;
+    }, [&]() { forget_cache(path); });
+
+    if (in_place > 0.0 && imported > 0.0)
+        spdlog::info("glb load of {} triangles: load_asset {:.2f} ms, in place {:.2f} ms, {:.1f}x",
+                     triangles, imported * 1e-6, in_place * 1e-6, imported / in_place);
+
+    forget_cache(path);
+    std::filesystem::remove(path);
+}
+
+
+/* Benchmarks that need a context, in a hidden window. Skipped when none can be created. */
+static void benchmark_gl() {
+    if (!selected("light_buffer") && !selected("get_location") && !selected("load_glb"))
+        return;
+
+    glfw_t glfw;
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window_t window{ glfwCreateWindow(64, 64, "benchmarks", NULL, NULL), glfwDestroyWindow };
+    if (!window) {
+        spdlog::warn("No OpenGL context, skipping the light_buffer, get_location and load_glb benchmarks");
+        return;
+    }
+
+    glfwMakeContextCurrent(window.get());
+    if (glewInit() != GLEW_OK) {
+        spdlog::warn("Failed to initialize glew, skipping the light_buffer, get_location and load_glb benchmarks");
+        return;
+    }
+
+    shader_variant variant;
+    variant.textured = true;
+    variant.max_lights = light_bucket(64);
+
+    program_t program = load_program("vertex.glsl", "fragment.glsl", variant.defines());
+
+    /* The lookup the setup callback of main makes for every textured variant */
+    const size_t lookups = 4096;
+
+    measure("get_location", lookups, 31, [&]() {
+        int sum = 0;
+        for (size_t i = 0; i < lookups; ++i)
+            sum += get_location(program.get(), "u_tex");
+
+        sink = (float)sum;
+    });
+
+    for (size_t count : { 64, 256 }) {
+        light_buffer buffer;
+        buffer.setup_program(program.get(), 0);
+
+        std::vector<light> lights;
+        for (size_t i = 0; i < count; ++i)
+            lights.emplace_back(glm::vec3{ (float)i, 0.0f, 0.0f });
+
+        buffer.update(lights);
+
+        /* Like the main loop, where the lights circling the ferraris move and the rest stay */
+        size_t frame = 0;
+        auto move_some = [&]() {
+            ++frame;
+            for (size_t i = 0; i < count; i += 8)
+                lights[i].position.y = (float)frame;
+        };
+
+        measure("light_buffer/update/" + std::to_string(count), count, 101, [&]() {
+            buffer.update(lights);
+        }, move_some);
+
+        measure("light_buffer/update_unchanged/" + std::to_string(count), count, 101, [&]() {
+            buffer.update(lights);
+        });
+    }
+
+    benchmark_load_glb(1000000, 5);
+
+    glFinish();
+}
+
+
+/* Google Benchmark's JSON layout, so its compare.py can diff two runs */
+static void write_results(const std::string &path) {
+    std::ofstream out{ path };
+    if (!out) {
+        spdlog::error("Failed to write benchmark results to {}", path);
+        return;
+    }
+
+    out << "{\n  \"context\": { \"library_build_type\": \"" <<
+#ifdef NDEBUG
+        "release"
+#else
+        "debug"
+#endif
+        << "\" },\n  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const benchmark_result &result = results[i];
+
+        out << "    { \"name\": \"" << result.name << "\", \"run_type\": \"iteration\", \"iterations\": " << result.repetitions
+            << ", \"items\": " << result.items << ", \"real_time\": " << result.median << ", \"cpu_time\": " << result.median
+            << ", \"min_time\": " << result.min << ", \"max_time\": " << result.max
+            << ", \"time_unit\": \"ns\", \"items_per_second\": " << (result.median > 0.0 ? 1e9 / result.median : 0.0)
+            << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    out << "  ]\n}\n";
+
+    spdlog::info("{} benchmark results written to {}", results.size(), path);
+}
+
+
+void run_benchmarks(int argc, char **argv) {
+    std::string results_path = "benchmarks.json";
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg{ argv[i] };
+
+        if (arg == "--filter" && i + 1 < argc)
+            name_filter = argv[++i];
+        else
+            results_path = arg;
+    }
+
+    for (size_t count : { 64, 1024, 16384 })
+        benchmark_transforms(count);
+
+    benchmark_euler_angles(1 << 20);
+
+    benchmark_frustum_cull(100000);
+
+    for (size_t count : { 64, 1024 })
+        benchmark_light_names(count);
+
+    benchmark_load_asset("cube.obj", 15);
+    benchmark_load_asset("monkey.obj", 15);
+    benchmark_load_asset("ferrari.obj", 5);
+    benchmark_load_asset("new_tree2.obj", 5);
+
+    benchmark_decode_image("ferrari.png", 5);
+    benchmark_decode_image("tree.jpg", 5);
+
+    try {
+        benchmark_gl();
+    } catch (const std::exception &ex) {
+        spdlog::warn("Skipping the OpenGL benchmarks: {}", ex.what());
+    }
+
+    benchmark_obj_import("monkey.obj", 15);
+    benchmark_obj_import("cube.obj", 15);
+
+    benchmark_scene_import(1000000, 16, 5);
+
+    /* Writing 10 million triangles takes a while, so only when the import cases run */
+    if (selected("import_assimp/synthetic.obj") || selected("import_obj/synthetic.obj")) {
+        auto synthetic = write_synthetic_obj("synthetic.obj", 10000000);
+        if (synthetic.empty()) {
+            spdlog::error("Failed to write the synthetic obj");
+        } else {
+            benchmark_obj_import(synthetic.string(), 3);
+            std::filesystem::remove(synthetic);
+        }
+    }
+
+    for (const benchmark_result &result : results)
+        spdlog::info("{:<48} {:>14.1f} ns/item (min {:.1f}, max {:.1f}, {} items x {})",
+                     result.name, result.median, result.min, result.max, result.items, result.repetitions);
+
+    write_results(results_path);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+
+/* Timings of the CPU hot paths against the code they replaced, run with
+ * --bench [results.json] [--filter text] instead of opening a window. Only cases whose
+ * name contains the filter text run. Results go to the log and, in Google Benchmark's
+ * JSON layout, to the results file. */
+void run_benchmarks(int argc, char **argv);
@@ -0,0 +1,194 @@
+#include "cluster.h"
+#include "light.h"
+#include "shader.h"
+#include <algorithm>
+#include <cmath>
+
+
+cluster_grid::cluster_grid(float fov, float aspect, float near_plane, float far_plane)
+    : bins_(n_clusters), grid_(n_clusters), grid_buffer_(gen_buffer()), index_buffer_(gen_buffer()),
+      grid_texture_(gen_texture()), index_texture_(gen_texture()) {
+    set_projection(fov, aspect, near_plane, far_plane);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, grid_buffer_.get());
+    glBufferData(GL_TEXTURE_BUFFER, grid_.size() * sizeof(grid_[0]), NULL, GL_STREAM_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, grid_texture_.get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, grid_buffer_.get());
+
+    glBindTexture(GL_TEXTURE_BUFFER, index_texture_.get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, index_buffer_.get());
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+void cluster_grid::set_projection(float fov, float aspect, float near_plane, float far_plane) {
+    tan_half_fov_ = std::tan(fov / 2);
+    aspect_ = aspect;
+    near_ = near_plane;
+    far_ = far_plane;
+
+    cluster_min_.resize(n_clusters);
+    cluster_max_.resize(n_clusters);
+
+    /* Clusters are stored with a positive depth axis, the z of the view space
+     * position of a light is negated before testing against them. */
+    for (int k = 0; k < slices; ++k) {
+        float z0 = near_ * std::pow(far_ / near_, (float)k / slices);
+        float z1 = near_ * std::pow(far_ / near_, (float)(k + 1) / slices);
+
+        for (int j = 0; j < tiles_y; ++j) {
+            float y0 = (-1.0f + 2.0f * j / tiles_y) * tan_half_fov_;
+            float y1 = (-1.0f + 2.0f * (j + 1) / tiles_y) * tan_half_fov_;
+
+            for (int i = 0; i < tiles_x; ++i) {
+                float x0 = (-1.0f + 2.0f * i / tiles_x) * tan_half_fov_ * aspect_;
+                float x1 = (-1.0f + 2.0f * (i + 1) / tiles_x) * tan_half_fov_ * aspect_;
+
+                int index = i + tiles_x * (j + tiles_y * k);
+
+                cluster_min_[index] = glm::vec3{
+                    std::min(x0 * z0, x0 * z1), std::min(y0 * z0, y0 * z1), z0 };
+                cluster_max_[index] = glm::vec3{
+                    std::max(x1 * z0, x1 * z1), std::max(y1 * z0, y1 * z1), z1 };
+            }
+        }
+    }
+}
+
+
+int cluster_grid::slice_of(float depth) const {
+    int slice = (int)(std::log(depth / near_) / std::log(far_ / near_) * slices);
+
+    return std::clamp(slice, 0, slices - 1);
+}
+
+
+void cluster_grid::build(const glm::mat4 &view, const std::vector<light> &lights, size_t count) {
+    for (auto &bin : bins_)
+        bin.clear();
+
+    stats_ = cluster_stats{};
+    count = std::min(count, lights.size());
+    stats_.lights_total = count;
+
+    for (uint32_t l = 0; l < count; ++l) {
+        glm::vec3 p = glm::vec3(view * glm::vec4(lights[l].position, 1.0f));
+        p.z = -p.z;
+
+        float r = lights[l].radius(attenuation_threshold);
+        bool global = std::isinf(r);
+
+        if (!global && (r <= 0.0f || p.z + r < near_ || p.z - r > far_)) {
+            ++stats_.lights_culled;
+            continue;
+        }
+
+        int k0 = 0, k1 = slices - 1;
+        int i0 = 0, i1 = tiles_x - 1;
+        int j0 = 0, j1 = tiles_y - 1;
+
+        if (!global) {
+            float zmin = std::max(p.z - r, near_);
+            float zmax = std::min(p.z + r, far_);
+
+            k0 = slice_of(zmin);
+            k1 = slice_of(zmax);
+
+            /* The extremes of x / z over the bounding box of the sphere are reached at its corners */
+            float sx = 1.0f / (tan_half_fov_ * aspect_);
+            float sy = 1.0f / tan_half_fov_;
+
+            float xmin = std::min((p.x - r) / zmin, (p.x - r) / zmax) * sx;
+            float xmax = std::max((p.x + r) / zmin, (p.x + r) / zmax) * sx;
+            float ymin = std::min((p.y - r) / zmin, (p.y - r) / zmax) * sy;
+            float ymax = std::max((p.y + r) / zmin, (p.y + r) / zmax) * sy;
+
+            if (xmax < -1.0f || xmin > 1.0f || ymax < -1.0f || ymin > 1.0f) {
+                ++stats_.lights_culled;
+                continue;
+            }
+
+            i0 = std::clamp((int)((xmin * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1);
+            i1 = std::clamp((int)((xmax * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1);
+            j0 = std::clamp((int)((ymin * 0.5f + 0.5f) * tiles_y), 0, tiles_y - 1);
+            j1 = std::clamp((int)((ymax * 0.5f + 0.5f) * tiles_y), 0, tiles_y - 1);
+        }
+
+        bool touched = false;
+        for (int k = k0; k <= k1; ++k) {
+            for (int j = j0; j <= j1; ++j) {
+                for (int i = i0; i <= i1; ++i) {
+                    int index = i + tiles_x * (j + tiles_y * k);
+
+                    if (!global) {
+                        glm::vec3 closest = glm::clamp(p, cluster_min_[index], cluster_max_[index]);
+                        glm::vec3 d = closest - p;
+                        if (glm::dot(d, d) > r * r)
+                            continue;
+                    }
+
+                    bins_[index].push_back(l);
+                    touched = true;
+                }
+            }
+        }
+
+        if (!touched)
+            ++stats_.lights_culled;
+    }
+
+    indices_.clear();
+    for (int c = 0; c < n_clusters; ++c) {
+        grid_[c] = glm::uvec2{ (uint32_t)indices_.size(), (uint32_t)bins_[c].size() };
+        indices_.insert(indices_.end(), bins_[c].begin(), bins_[c].end());
+
+        stats_.max_lights_per_cluster = std::max(stats_.max_lights_per_cluster, bins_[c].size());
+        if (!bins_[c].empty())
+            ++stats_.occupied_clusters;
+    }
+    stats_.light_references = indices_.size();
+
+    upload();
+}
+
+
+void cluster_grid::upload() {
+    glBindBuffer(GL_TEXTURE_BUFFER, grid_buffer_.get());
+    glBufferData(GL_TEXTURE_BUFFER, grid_.size() * sizeof(grid_[0]), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, grid_.size() * sizeof(grid_[0]), grid_.data());
+
+    /* Orphan the index buffer every frame, it only ever grows so the
+     * driver can hand back a store of the same size */
+    index_capacity_ = std::max(index_capacity_, std::max(indices_.size(), (size_t)1));
+
+    glBindBuffer(GL_TEXTURE_BUFFER, index_buffer_.get());
+    glBufferData(GL_TEXTURE_BUFFER, index_capacity_ * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, indices_.size() * sizeof(uint32_t), indices_.data());
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+void cluster_grid::setup_program(uint32_t program, int grid_unit, int index_unit) const {
+    glUniform1i(get_location(program, "u_cluster_grid"), grid_unit);
+    glUniform1i(get_location(program, "u_cluster_lights"), index_unit);
+
+    glUniform3i(get_location(program, "u_cluster_dims"), tiles_x, tiles_y, slices);
+
+    float scale = slices / std::log(far_ / near_);
+    glUniform2f(get_location(program, "u_cluster_slice_params"), scale, -std::log(near_) * scale);
+}
+
+
+void cluster_grid::bind(int grid_unit, int index_unit) const {
+    glActiveTexture(GL_TEXTURE0 + grid_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, grid_texture_.get());
+
+    glActiveTexture(GL_TEXTURE0 + index_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, index_texture_.get());
+
+    glActiveTexture(GL_TEXTURE0);
+}
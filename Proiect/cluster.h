@@ -0,0 +1,79 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+
+class light;
+
+
+struct cluster_stats {
+    size_t lights_total = 0;
+    size_t lights_culled = 0;
+    size_t light_references = 0;
+    size_t max_lights_per_cluster = 0;
+    size_t occupied_clusters = 0;
+};
+
+
+/* View space froxel grid used for clustered forward shading.
+ *
+ * Every frame the lights are binned into the clusters their influence sphere touches and
+ * the result is uploaded as two buffer textures: one (offset, count) pair per cluster and
+ * a compact list of light indices the pairs point into. */
+class cluster_grid {
+public:
+    static constexpr int tiles_x = 16;
+    static constexpr int tiles_y = 9;
+    static constexpr int slices = 24;
+    static constexpr int n_clusters = tiles_x * tiles_y * slices;
+
+    cluster_grid(float fov, float aspect, float near_plane, float far_plane);
+
+    cluster_grid(const cluster_grid &other) = delete;
+    cluster_grid &operator=(const cluster_grid &other) = delete;
+
+    void set_projection(float fov, float aspect, float near_plane, float far_plane);
+
+    /* Bins the first count lights only, the shader can't index past what the light buffer holds */
+    void build(const glm::mat4 &view, const std::vector<light> &lights, size_t count);
+
+    /* Sets the sampler units and the grid layout uniforms, program must be in use. */
+    void setup_program(uint32_t program, int grid_unit, int index_unit) const;
+
+    void bind(int grid_unit, int index_unit) const;
+
+    const cluster_stats &stats() const { return stats_; }
+
+    /* Lights are cut off once they contribute less than this to any channel. */
+    float attenuation_threshold = 1.0f / 256.0f;
+
+private:
+    int slice_of(float depth) const;
+
+    void upload();
+
+    float tan_half_fov_;
+    float aspect_;
+    float near_;
+    float far_;
+
+    std::vector<glm::vec3> cluster_min_;
+    std::vector<glm::vec3> cluster_max_;
+
+    std::vector<std::vector<uint32_t>> bins_;
+    std::vector<glm::uvec2> grid_;
+    std::vector<uint32_t> indices_;
+
+    buffer_t grid_buffer_;
+    buffer_t index_buffer_;
+    texture_t grid_texture_;
+    texture_t index_texture_;
+
+    size_t index_capacity_ = 0;
+
+    cluster_stats stats_;
+};
@@ -1,17 +1,11 @@
 #pragma once
 
 
+#include "loader.h"
 #include <glm/glm.hpp>
 
 
-struct vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 tex_coords;
-};
-
-
-static vertex vertices[] = {
+static const loader::vertex vertices[] = {
     {{-0.5f, -0.5f, -0.5f}, {0.0f,  0.0f, -1.0f}, {}},
     {{0.5f, -0.5f, -0.5f}, {0.0f,  0.0f, -1.0f}, {}},
     {{0.5f,  0.5f, -0.5f}, {0.0f,  0.0f, -1.0f}, {}},
@@ -54,3 +48,6 @@ static vertex vertices[] = {
     {{-0.5f,  0.5f,  0.5f},  {0.0f,  1.0f,  0.0f}, {}},
     {{-0.5f,  0.5f, -0.5f},  {0.0f,  1.0f,  0.0f}, {}}
 };
+
+
+constexpr size_t n_vertices = sizeof(vertices) / sizeof(vertices[0]);
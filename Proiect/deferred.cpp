@@ -0,0 +1,87 @@
+#include "deferred.h"
+#include "shader.h"
+
+
+static void allocate(uint32_t texture, GLint internal_format, GLenum format, GLenum type, int width, int height) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+
+    /* Read with texelFetch only */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+
+deferred_pass::deferred_pass()
+    : framebuffer_(gen_framebuffer()), albedo_(gen_texture()), normal_(gen_texture()), depth_(gen_texture()),
+    empty_vao_(gen_vertex_array()) {}
+
+
+void deferred_pass::resize(int width, int height) {
+    if (width == width_ && height == height_)
+        return;
+
+    width_ = width;
+    height_ = height;
+
+    allocate(albedo_.get(), GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    allocate(normal_.get(), GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+    allocate(depth_.get(), GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_.get(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_.get(), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_.get(), 0);
+
+    const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        throw framebuffer_error(status);
+}
+
+
+void deferred_pass::begin(glm::vec3 clear_color) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+    glViewport(0, 0, width_, height_);
+
+    const GLfloat albedo[] = { clear_color.r, clear_color.g, clear_color.b, 0.0f };
+    const GLfloat normal[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, albedo);
+    glClearBufferfv(GL_COLOR, 1, normal);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+
+void deferred_pass::setup_program(uint32_t program, int first_unit) const {
+    glUniform1i(get_location(program, "u_gbuffer_albedo"), first_unit);
+    glUniform1i(get_location(program, "u_gbuffer_normal"), first_unit + 1);
+    glUniform1i(get_location(program, "u_gbuffer_depth"), first_unit + 2);
+}
+
+
+void deferred_pass::shade(uint32_t program, const glm::mat4 &view_proj, int first_unit) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(get_location(program, "u_inverse_view_proj"), 1, GL_FALSE, &glm::inverse(view_proj)[0][0]);
+
+    const uint32_t textures[] = { albedo_.get(), normal_.get(), depth_.get() };
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + first_unit + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glBindVertexArray(empty_vao_.get());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+}
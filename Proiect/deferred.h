@@ -0,0 +1,62 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+
+struct framebuffer_error : public std::exception {
+    explicit framebuffer_error(uint32_t status)
+        : message_("The G-buffer is incomplete, status " + std::to_string(status)) {}
+
+    const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+    std::string message_;
+};
+
+
+/* G-buffer of the deferred path and the full screen pass that lights it.
+ *
+ * The scene is drawn into the G-buffer with the GBUFFER shader variants: albedo
+ * with a lit flag in alpha, the interpolated normal and depth. shade() then runs
+ * a DEFERRED variant of fragment.glsl over the screen, which rebuilds the world
+ * position from depth and walks the same light loop or clusters as forward
+ * shading does, so the cost is one lighting evaluation per pixel whatever the
+ * overdraw. Unlit pixels and the background are copied through. */
+class deferred_pass {
+public:
+    deferred_pass();
+
+    deferred_pass(const deferred_pass &other) = delete;
+    deferred_pass &operator=(const deferred_pass &other) = delete;
+
+    /* Reallocates the attachments when the size changed */
+    void resize(int width, int height);
+
+    /* Binds the G-buffer and clears it, the albedo to the clear color as unlit */
+    void begin(glm::vec3 clear_color);
+
+    /* Sets the G-buffer samplers of a DEFERRED program, program must be in use */
+    void setup_program(uint32_t program, int first_unit) const;
+
+    /* Back on the default framebuffer, lights the G-buffer with program */
+    void shade(uint32_t program, const glm::mat4 &view_proj, int first_unit) const;
+
+private:
+    framebuffer_t framebuffer_;
+
+    /* RGBA8 albedo, RGBA16F normal, 32 bit float depth */
+    texture_t albedo_;
+    texture_t normal_;
+    texture_t depth_;
+
+    /* The full screen triangle has no attributes, but core profiles want a VAO bound */
+    vertex_array_t empty_vao_;
+
+    int width_ = 0;
+    int height_ = 0;
+};
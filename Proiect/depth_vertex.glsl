@@ -0,0 +1,29 @@
+#version 330
+
+
+// Position only stream, see gpu_mesh::depth_vao
+layout(location = 0) in vec3 v_pos;
+
+
+// Per instance attributes, see instance_batch
+layout(location = 3) in mat4 i_model;
+
+
+// Per frame values, see frame_uniforms
+layout(std140) uniform frame_block {
+    mat4 u_view;
+    mat4 u_proj;
+    vec3 u_viewpos;
+    int u_n_lights;
+    vec2 u_viewport_size;
+};
+
+
+// Computed exactly like vertex.glsl does, so the depths compare equal
+invariant gl_Position;
+
+
+void main() {
+    vec3 pos = vec3(i_model * vec4(v_pos, 1.0));
+    gl_Position = u_proj * u_view * vec4(pos, 1.0f);
+}
@@ -1,26 +1,67 @@
 #version 330
 
+#ifdef GL_ARB_shader_storage_buffer_object
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 
+
+#ifdef DEFERRED
+// Read back from the G-buffer at the start of main
+vec3 normal = vec3(0.0);
+vec3 pos = vec3(0.0);
+float view_depth = 0.0;
+#else
 in vec3 normal;
 in vec3 pos;
 in vec2 uv_coords;
+in float view_depth;
+flat in vec3 instance_color;
+#endif
 
 
+#ifdef GBUFFER
+// Albedo with alpha 1 on lit surfaces, and the interpolated normal, see deferred_pass
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec4 g_normal;
+#else
 out vec4 fragColor;
+#endif
 
 
-// type 0 = textured
-// type 1 = colored
-// type 3 = light
-uniform int u_type;
+// Variants are selected with defines, see shader_variant:
+// LIT             lights the surface, unlit surfaces show their color as is
+// TEXTURED        the color comes from u_tex instead of the instance
+// CLUSTERED       only the lights of the fragment's cluster are visited
+// MAX_LIGHTS n    constant bound of the loop over all lights
+// GBUFFER         writes the G-buffer instead of shading, LIT only marks the surface as lit
+// DEFERRED        shades the pixels of the G-buffer, drawn over the screen by deferred_pass
 
-uniform vec3 u_color;
-uniform int u_n_lights;
 
+// Per frame values, see frame_uniforms
+layout(std140) uniform frame_block {
+	mat4 u_view;
+	mat4 u_proj;
+	vec3 u_viewpos;
+	int u_n_lights;
+	vec2 u_viewport_size;
+};
 
-uniform vec3 u_viewpos;
 
+#ifdef TEXTURED
 uniform sampler2D u_tex;
+#endif
+
+
+#ifdef DEFERRED
+uniform sampler2D u_gbuffer_albedo;
+uniform sampler2D u_gbuffer_normal;
+uniform sampler2D u_gbuffer_depth;
+
+uniform mat4 u_inverse_view_proj;
+#endif
+
+
+#if defined(LIT) && !defined(GBUFFER)
 
 
 struct point_light {
@@ -57,28 +98,101 @@ vec3 calculate_point_light(point_light light, vec3 view_pos, vec3 object_pos, ve
 }
 
 
-uniform point_light u_light[256];
+// Filled by light_buffer, only the first u_n_lights entries are valid
+#ifdef GL_ARB_shader_storage_buffer_object
+layout(std430) buffer light_block {
+	point_light u_light[];
+};
+#else
+layout(std140) uniform light_block {
+	point_light u_light[256];
+};
+#endif
 
 
-uniform vec3 u_light_color;
+#ifdef CLUSTERED
+// Clustered shading, see cluster_grid
+uniform usamplerBuffer u_cluster_grid;
+uniform usamplerBuffer u_cluster_lights;
 
+uniform ivec3 u_cluster_dims;
+uniform vec2 u_cluster_slice_params;
+#endif
 
-void main() {
-	vec3 color;
-	if (u_type == 2) {
-		color = u_light_color;
-	} else {
-		vec3 light = vec3(0.0f);
-		for (int i = 0; i < u_n_lights; ++i) {
-			light += calculate_point_light(u_light[i], u_viewpos, pos, normal) * u_light[i].color;
-		}
 
-		if (u_type == 0) {
-			color = min(light * texture(u_tex, uv_coords).rgb, 1.0f);
-		} else if (u_type == 1) {
-			color = min(light * u_color, 1.0f);
+vec3 accumulate_lights() {
+	vec3 light = vec3(0.0f);
+
+#ifdef CLUSTERED
+	{
+		ivec2 tile = clamp(ivec2(gl_FragCoord.xy / u_viewport_size * vec2(u_cluster_dims.xy)),
+			ivec2(0), u_cluster_dims.xy - 1);
+		int slice = clamp(int(log(view_depth) * u_cluster_slice_params.x + u_cluster_slice_params.y),
+			0, u_cluster_dims.z - 1);
+
+		int cluster = tile.x + u_cluster_dims.x * (tile.y + u_cluster_dims.y * slice);
+		uvec2 range = texelFetch(u_cluster_grid, cluster).xy;
+
+		for (uint i = 0u; i < range.y; ++i) {
+			int index = int(texelFetch(u_cluster_lights, int(range.x + i)).r);
+			light += calculate_point_light(u_light[index], u_viewpos, pos, normal) * u_light[index].color;
 		}
 	}
+#elif defined(MAX_LIGHTS)
+	for (int i = 0; i < MAX_LIGHTS; ++i) {
+		if (i >= u_n_lights)
+			break;
+
+		light += calculate_point_light(u_light[i], u_viewpos, pos, normal) * u_light[i].color;
+	}
+#else
+	for (int i = 0; i < u_n_lights; ++i) {
+		light += calculate_point_light(u_light[i], u_viewpos, pos, normal) * u_light[i].color;
+	}
+#endif
+
+	return light;
+}
+#endif
+
+
+void main() {
+#ifdef DEFERRED
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 albedo = texelFetch(u_gbuffer_albedo, texel, 0);
+
+	// Unlit surfaces and the background, which is cleared to the clear color, pass through
+	if (albedo.a == 0.0) {
+		fragColor = vec4(albedo.rgb, 1.0);
+		return;
+	}
+
+	float depth = texelFetch(u_gbuffer_depth, texel, 0).r;
+	vec4 world = u_inverse_view_proj * vec4(gl_FragCoord.xy / u_viewport_size * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+
+	pos = world.xyz / world.w;
+	normal = texelFetch(u_gbuffer_normal, texel, 0).xyz;
+	view_depth = -(u_view * vec4(pos, 1.0)).z;
+
+	vec3 color = albedo.rgb;
+#elif defined(TEXTURED)
+	vec3 color = texture(u_tex, uv_coords).rgb;
+#else
+	vec3 color = instance_color;
+#endif
+
+#ifdef GBUFFER
+#ifdef LIT
+	fragColor = vec4(color, 1.0);
+#else
+	fragColor = vec4(color, 0.0);
+#endif
+	g_normal = vec4(normal, 0.0);
+#else
+#ifdef LIT
+	color = min(accumulate_lights() * color, 1.0f);
+#endif
 
 	fragColor = vec4(color, 1.0);
+#endif
 }
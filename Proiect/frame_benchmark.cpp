@@ -0,0 +1,271 @@
+#include "frame_benchmark.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+
+static const char *phase_names[n_frame_phases] = { "ui", "update", "cull", "batch", "draw", "present" };
+
+/* Frames one orbit of the camera takes */
+static constexpr int orbit_frames = 900;
+
+
+/* Nearest rank percentile of sorted samples */
+static double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0.0;
+
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+
+static void write_distribution(std::ofstream &out, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+
+    double mean = samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+    out << "{ \"mean\": " << mean
+        << ", \"p50\": " << percentile(samples, 50.0)
+        << ", \"p95\": " << percentile(samples, 95.0)
+        << ", \"p99\": " << percentile(samples, 99.0)
+        << ", \"max\": " << (samples.empty() ? 0.0 : samples.back()) << " }";
+}
+
+
+static void write_count(std::ofstream &out, const std::vector<size_t> &samples) {
+    std::vector<double> values(samples.begin(), samples.end());
+
+    write_distribution(out, std::move(values));
+}
+
+
+static double mean(const std::vector<size_t> &samples) {
+    return samples.empty() ? 0.0 : (double)std::accumulate(samples.begin(), samples.end(), (size_t)0) / samples.size();
+}
+
+
+static double mean(const std::vector<double> &samples) {
+    return samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+
+static std::string escape(const char *text) {
+    std::string escaped;
+
+    for (const char *c = text; c && *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            escaped += '\\';
+
+        if ((unsigned char)*c >= 0x20)
+            escaped += *c;
+    }
+
+    return escaped;
+}
+
+
+frame_benchmark::frame_benchmark(const frame_benchmark_options &options) : options_(options) {
+    frame_ms_.reserve(options_.measured_frames);
+    for (auto &samples : phases_ms_)
+        samples.reserve(options_.measured_frames);
+}
+
+
+void frame_benchmark::camera(glm::vec3 &position, glm::vec3 &forward) const {
+    /* Circles the ferraris while rising and sinking, so the tree and the platform go
+     * from filling the view to being seen from far above */
+    float t = (float)(frame_ % orbit_frames) / orbit_frames;
+    float angle = glm::radians(360.0f) * t;
+    float height = 25.0f + 15.0f * std::sin(2.0f * angle);
+    float radius = 45.0f - 15.0f * std::cos(angle);
+
+    position = glm::vec3{ radius * std::cos(angle), height, radius * std::sin(angle) };
+    forward = glm::normalize(glm::vec3{ 0.0f, 2.0f, 0.0f } - position);
+}
+
+
+void frame_benchmark::begin_frame() {
+    frame_start_ = clock::now();
+    phase_start_ = frame_start_;
+    phase_ms_.fill(0.0);
+}
+
+
+void frame_benchmark::end_phase(frame_phase phase) {
+    clock::time_point now = clock::now();
+
+    phase_ms_[(size_t)phase] += std::chrono::duration<double, std::milli>(now - phase_start_).count();
+    phase_start_ = now;
+}
+
+
+void frame_benchmark::end_frame(const render_queue_stats &stats, size_t triangles, const gpu_timer &gpu) {
+    if (frame_++ < options_.warmup_frames)
+        return;
+
+    frame_ms_.push_back(std::chrono::duration<double, std::milli>(clock::now() - frame_start_).count());
+
+    for (size_t i = 0; i < n_frame_phases; ++i)
+        phases_ms_[i].push_back(phase_ms_[i]);
+
+    draws_.push_back(stats.draws_submitted);
+    binds_issued_.push_back(stats.binds_issued);
+    binds_elided_.push_back(stats.binds_elided);
+    triangles_.push_back(triangles);
+
+    if (!gpu.resolved())
+        return;
+
+    gpu_frame_ms_.push_back(gpu.frame_ms());
+
+    for (const gpu_section_time &section : gpu.sections()) {
+        auto samples = std::find_if(gpu_passes_ms_.begin(), gpu_passes_ms_.end(),
+            [&](const gpu_samples &s) { return s.path == section.path; });
+
+        if (samples == gpu_passes_ms_.end()) {
+            gpu_passes_ms_.push_back({ section.path, {} });
+            samples = gpu_passes_ms_.end() - 1;
+        }
+
+        samples->ms.push_back(section.ms);
+    }
+}
+
+
+frame_benchmark_summary frame_benchmark::summary() const {
+    frame_benchmark_summary summary;
+
+    std::vector<double> sorted = frame_ms_;
+    std::sort(sorted.begin(), sorted.end());
+
+    summary.frames = sorted.size();
+    summary.mean_ms = sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+    summary.p50_ms = percentile(sorted, 50.0);
+    summary.p95_ms = percentile(sorted, 95.0);
+    summary.p99_ms = percentile(sorted, 99.0);
+
+    for (size_t i = 0; i < n_frame_phases; ++i)
+        summary.phase_mean_ms[i] = mean(phases_ms_[i]);
+
+    summary.draws = mean(draws_);
+    summary.binds_issued = mean(binds_issued_);
+    summary.triangles = mean(triangles_);
+
+    summary.gpu_mean_ms = mean(gpu_frame_ms_);
+    for (const gpu_samples &samples : gpu_passes_ms_)
+        summary.gpu_pass_mean_ms.emplace_back(samples.path, mean(samples.ms));
+
+    return summary;
+}
+
+
+void frame_benchmark::write_report(const char *renderer, const char *version) const {
+    std::ofstream out{ options_.report_path };
+    if (!out)
+        throw benchmark_error(options_.report_path);
+
+    out << "{\n";
+    out << "  \"renderer\": \"" << escape(renderer) << "\",\n";
+    out << "  \"version\": \"" << escape(version) << "\",\n";
+    out << "  \"width\": " << options_.width << ",\n";
+    out << "  \"height\": " << options_.height << ",\n";
+    out << "  \"warmup_frames\": " << options_.warmup_frames << ",\n";
+    out << "  \"measured_frames\": " << frame_ms_.size() << ",\n";
+
+    out << "  \"frame_ms\": ";
+    write_distribution(out, frame_ms_);
+    out << ",\n";
+
+    out << "  \"phases_ms\": {\n";
+    for (size_t i = 0; i < n_frame_phases; ++i) {
+        out << "    \"" << phase_names[i] << "\": ";
+        write_distribution(out, phases_ms_[i]);
+        out << (i + 1 < n_frame_phases ? ",\n" : "\n");
+    }
+    out << "  },\n";
+
+    /* Without timestamp queries there are no GPU frames and the passes are empty */
+    out << "  \"gpu_frames\": " << gpu_frame_ms_.size() << ",\n";
+    out << "  \"gpu_frame_ms\": ";
+    write_distribution(out, gpu_frame_ms_);
+    out << ",\n";
+
+    out << "  \"gpu_passes_ms\": {";
+    for (size_t i = 0; i < gpu_passes_ms_.size(); ++i) {
+        out << (i ? ",\n" : "\n") << "    \"" << escape(gpu_passes_ms_[i].path.c_str()) << "\": ";
+        write_distribution(out, gpu_passes_ms_[i].ms);
+    }
+    out << (gpu_passes_ms_.empty() ? "},\n" : "\n  },\n");
+
+    out << "  \"draws\": ";
+    write_count(out, draws_);
+    out << ",\n  \"binds_issued\": ";
+    write_count(out, binds_issued_);
+    out << ",\n  \"binds_elided\": ";
+    write_count(out, binds_elided_);
+    out << ",\n  \"triangles\": ";
+    write_count(out, triangles_);
+    out << "\n}\n";
+
+    out.close();
+    if (!out)
+        throw benchmark_error(options_.report_path);
+
+    std::vector<double> sorted = frame_ms_;
+    std::sort(sorted.begin(), sorted.end());
+
+    spdlog::info("Benchmark over {} frames: p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, GPU mean {:.3f} ms, report in {}",
+        sorted.size(), percentile(sorted, 50.0), percentile(sorted, 95.0), percentile(sorted, 99.0), mean(gpu_frame_ms_),
+        options_.report_path);
+}
+
+
+void write_sweep_report(const frame_benchmark_options &options, const char *layout, uint32_t seed,
+                        const std::vector<sweep_point> &points, const char *renderer, const char *version) {
+    std::ofstream out{ options.report_path };
+    if (!out)
+        throw benchmark_error(options.report_path);
+
+    out << "{\n";
+    out << "  \"renderer\": \"" << escape(renderer) << "\",\n";
+    out << "  \"version\": \"" << escape(version) << "\",\n";
+    out << "  \"width\": " << options.width << ",\n";
+    out << "  \"height\": " << options.height << ",\n";
+    out << "  \"warmup_frames\": " << options.warmup_frames << ",\n";
+    out << "  \"measured_frames\": " << options.measured_frames << ",\n";
+    out << "  \"layout\": \"" << layout << "\",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"points\": [\n";
+
+    for (size_t p = 0; p < points.size(); ++p) {
+        const sweep_point &point = points[p];
+        const frame_benchmark_summary &s = point.summary;
+
+        out << "    { \"objects\": " << point.objects << ", \"lights\": " << point.lights
+            << ", \"frame_ms\": { \"mean\": " << s.mean_ms << ", \"p50\": " << s.p50_ms
+            << ", \"p95\": " << s.p95_ms << ", \"p99\": " << s.p99_ms << " }, \"phases_ms\": { ";
+
+        for (size_t i = 0; i < n_frame_phases; ++i)
+            out << "\"" << phase_names[i] << "\": " << s.phase_mean_ms[i] << (i + 1 < n_frame_phases ? ", " : " }");
+
+        out << ", \"gpu_ms\": { \"frame\": " << s.gpu_mean_ms;
+        for (const auto &pass : s.gpu_pass_mean_ms)
+            out << ", \"" << escape(pass.first.c_str()) << "\": " << pass.second;
+        out << " }";
+
+        out << ", \"draws\": " << s.draws << ", \"binds_issued\": " << s.binds_issued
+            << ", \"triangles\": " << s.triangles << " }" << (p + 1 < points.size() ? ",\n" : "\n");
+    }
+
+    out << "  ]\n}\n";
+
+    out.close();
+    if (!out)
+        throw benchmark_error(options.report_path);
+
+    spdlog::info("Sweep of {} scenes written to {}", points.size(), options.report_path);
+}
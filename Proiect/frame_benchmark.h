@@ -0,0 +1,149 @@
+#pragma once
+
+
+#include "render_queue.h"
+#include "gpu_timer.h"
+#include <glm/glm.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+struct benchmark_error : public std::exception {
+    benchmark_error(const std::string &path) : message_("Failed to write benchmark report: " + path) {}
+
+    const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+    std::string message_;
+};
+
+
+/* Where the hidden window's context comes from. native is the platform's own (WGL, GLX),
+ * which Mesa's drop-in llvmpipe driver serves without a GPU. The others need GLEW built
+ * for that API too, with GLEW_EGL or GLEW_OSMESA, or its entry points go to the wrong one. */
+enum class context_api {
+    native,
+    egl,
+    osmesa,
+};
+
+
+struct frame_benchmark_options {
+    int warmup_frames = 120;
+    int measured_frames = 1000;
+    int width = 1280;
+    int height = 720;
+    context_api context = context_api::native;
+    std::string report_path = "benchmark.json";
+};
+
+
+/* Parts of a frame timed on their own, in the order run_main_loop goes through them.
+ * present covers the animation step, the ImGui draw and the buffer swap. */
+enum class frame_phase : uint32_t {
+    ui,
+    update,
+    cull,
+    batch,
+    draw,
+    present,
+};
+
+constexpr size_t n_frame_phases = 6;
+
+
+/* Means and frame time percentiles of a run, for comparing runs side by side */
+struct frame_benchmark_summary {
+    size_t frames = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    std::array<double, n_frame_phases> phase_mean_ms{};
+    double draws = 0.0;
+    double binds_issued = 0.0;
+    double triangles = 0.0;
+    /* Zero, and no passes, without timestamp queries */
+    double gpu_mean_ms = 0.0;
+    std::vector<std::pair<std::string, double>> gpu_pass_mean_ms;
+};
+
+
+/* One run of a sweep over generated scenes */
+struct sweep_point {
+    uint32_t objects;
+    uint32_t lights;
+    frame_benchmark_summary summary;
+};
+
+
+/* Drives run_main_loop through a fixed run: the camera follows a scripted orbit and the
+ * animations advance by a fixed step, so every run draws the same frames. Warmup frames
+ * are drawn but not recorded, the measured ones end up in a JSON report of the CPU frame
+ * time percentiles, the time of each phase, the GPU time of each pass and the draw and
+ * state change counts. */
+class frame_benchmark {
+public:
+    /* Animation time step of every frame, whatever the frame took */
+    static constexpr std::chrono::microseconds frame_step{ 16667 };
+
+    explicit frame_benchmark(const frame_benchmark_options &options);
+
+    const frame_benchmark_options &options() const { return options_; }
+
+    bool done() const { return frame_ >= options_.warmup_frames + options_.measured_frames; }
+
+    /* Viewer position and direction of the current frame */
+    void camera(glm::vec3 &position, glm::vec3 &forward) const;
+
+    void begin_frame();
+
+    /* Ends the phase running since the frame or the previous phase began */
+    void end_phase(frame_phase phase);
+
+    /* The GPU times are those of the frame gpu read back, a few frames older than this one */
+    void end_frame(const render_queue_stats &stats, size_t triangles, const gpu_timer &gpu);
+
+    frame_benchmark_summary summary() const;
+
+    /* Throws benchmark_error when the report can't be written */
+    void write_report(const char *renderer, const char *version) const;
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    frame_benchmark_options options_;
+    int frame_ = 0;
+
+    clock::time_point frame_start_;
+    clock::time_point phase_start_;
+    std::array<double, n_frame_phases> phase_ms_{};
+
+    /* Measured frames only */
+    std::vector<double> frame_ms_;
+    std::array<std::vector<double>, n_frame_phases> phases_ms_;
+    std::vector<size_t> draws_;
+    std::vector<size_t> binds_issued_;
+    std::vector<size_t> binds_elided_;
+    std::vector<size_t> triangles_;
+
+    /* Passes in the order they first showed up, a pass turned off has fewer samples */
+    struct gpu_samples {
+        std::string path;
+        std::vector<double> ms;
+    };
+
+    std::vector<double> gpu_frame_ms_;
+    std::vector<gpu_samples> gpu_passes_ms_;
+};
+
+
+/* Every point of a sweep in one report, as rows of a table: frame time, phases and GPU
+ * passes against object and light counts. Throws benchmark_error when the report can't be written. */
+void write_sweep_report(const frame_benchmark_options &options, const char *layout, uint32_t seed,
+                        const std::vector<sweep_point> &points, const char *renderer, const char *version);
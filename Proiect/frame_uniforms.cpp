@@ -0,0 +1,30 @@
+#include "frame_uniforms.h"
+#include "shader.h"
+
+
+frame_uniforms::frame_uniforms() : buffer_(gen_buffer()) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_.get());
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(packed_frame_uniforms), NULL, GL_DYNAMIC_DRAW);
+}
+
+
+void frame_uniforms::setup_program(uint32_t program, uint32_t binding) {
+    binding_ = binding;
+
+    GLuint index = glGetUniformBlockIndex(program, "frame_block");
+    if (index == GL_INVALID_INDEX)
+        throw gl_uniform_not_found_exception("frame_block");
+
+    glUniformBlockBinding(program, index, binding);
+}
+
+
+void frame_uniforms::update(const packed_frame_uniforms &values) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_.get());
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(values), &values);
+}
+
+
+void frame_uniforms::bind() {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_.get());
+}
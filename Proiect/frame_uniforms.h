@@ -0,0 +1,42 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+
+
+/* Layout of frame_block in vertex.glsl and fragment.glsl under std140 */
+struct packed_frame_uniforms {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::vec3 viewpos;
+    int n_lights;
+    glm::vec2 viewport_size;
+    float pad[2];
+};
+
+static_assert(sizeof(packed_frame_uniforms) == 160, "packed_frame_uniforms must match the std140 layout of frame_block");
+
+
+/* The uniforms every shader variant reads, kept in one uniform buffer so switching
+ * programs mid frame doesn't mean setting them again on each one */
+class frame_uniforms {
+public:
+    frame_uniforms();
+
+    frame_uniforms(const frame_uniforms &other) = delete;
+    frame_uniforms &operator=(const frame_uniforms &other) = delete;
+
+    /* Binds the frame_block of program to binding */
+    void setup_program(uint32_t program, uint32_t binding);
+
+    /* Uploads the values, once per frame */
+    void update(const packed_frame_uniforms &values);
+
+    void bind();
+
+private:
+    buffer_t buffer_;
+    uint32_t binding_ = 0;
+};
@@ -0,0 +1,205 @@
+#include "frustum_cull.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/* SSE2 is the baseline. The AVX path is compiled for AVX on its own and only taken when
+ * the CPU and OS support it, so the build needs no /arch:AVX. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULL_SSE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FRUSTUM_CULL_AVX_TARGET
+#else
+#define FRUSTUM_CULL_AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+
+/* Padding lanes get a radius no plane distance can beat, so they always fail */
+static constexpr size_t lane_padding = 8;
+static constexpr float padding_radius = -std::numeric_limits<float>::max();
+
+
+frustum extract_frustum(const glm::mat4 &view_proj) {
+    glm::mat4 m = glm::transpose(view_proj);
+
+    frustum f{ {
+        m[3] + m[0],
+        m[3] - m[0],
+        m[3] + m[1],
+        m[3] - m[1],
+        m[3] + m[2],
+        m[3] - m[2],
+    } };
+
+    for (auto &plane : f.planes)
+        plane /= glm::length(glm::vec3{ plane });
+
+    return f;
+}
+
+
+void cull_set::clear() {
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    radius_.clear();
+    size_ = 0;
+}
+
+
+uint32_t cull_set::add(glm::vec3 center, float radius) {
+    /* Keep the arrays a whole number of lanes long, the padding sits past size_ */
+    if (size_ == x_.size()) {
+        x_.resize(size_ + lane_padding, 0.0f);
+        y_.resize(size_ + lane_padding, 0.0f);
+        z_.resize(size_ + lane_padding, 0.0f);
+        radius_.resize(size_ + lane_padding, padding_radius);
+    }
+
+    x_[size_] = center.x;
+    y_[size_] = center.y;
+    z_[size_] = center.z;
+    radius_[size_] = radius;
+
+    return (uint32_t)size_++;
+}
+
+
+uint32_t cull_set::add(glm::vec3 center, float radius, const glm::mat4 &model) {
+    float scale = std::sqrt(std::max({
+        glm::dot(glm::vec3{ model[0] }, glm::vec3{ model[0] }),
+        glm::dot(glm::vec3{ model[1] }, glm::vec3{ model[1] }),
+        glm::dot(glm::vec3{ model[2] }, glm::vec3{ model[2] }),
+    }));
+
+    return add(glm::vec3{ model * glm::vec4{ center, 1.0f } }, radius * scale);
+}
+
+
+#if defined(FRUSTUM_CULL_SSE)
+/* AVX needs the CPU to have it and the OS to save the ymm registers */
+static bool cpu_has_avx() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    return avx && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+
+/* 8 spheres a step. The arrays are padded to a whole number of lanes. */
+FRUSTUM_CULL_AVX_TARGET
+static void cull_avx(const frustum &f, const float *xs, const float *ys, const float *zs, const float *radii, size_t size,
+                     std::vector<uint32_t> &visible) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(f.planes[p].x);
+        py[p] = _mm256_set1_ps(f.planes[p].y);
+        pz[p] = _mm256_set1_ps(f.planes[p].z);
+        pw[p] = _mm256_set1_ps(f.planes[p].w);
+    }
+
+    for (size_t i = 0; i < size; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radii + i));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+                _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_radius, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; mask; ++lane, mask >>= 1) {
+            if (mask & 1)
+                visible.push_back((uint32_t)(i + lane));
+        }
+    }
+}
+
+
+static void cull_sse(const frustum &f, const float *xs, const float *ys, const float *zs, const float *radii, size_t size,
+                     std::vector<uint32_t> &visible) {
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(f.planes[p].x);
+        py[p] = _mm_set1_ps(f.planes[p].y);
+        pz[p] = _mm_set1_ps(f.planes[p].z);
+        pw[p] = _mm_set1_ps(f.planes[p].w);
+    }
+
+    for (size_t i = 0; i < size; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radii + i));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_radius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; mask; ++lane, mask >>= 1) {
+            if (mask & 1)
+                visible.push_back((uint32_t)(i + lane));
+        }
+    }
+}
+#endif
+
+
+bool cull_set::avx_supported() {
+#if defined(FRUSTUM_CULL_SSE)
+    static const bool supported = cpu_has_avx();
+
+    return supported;
+#else
+    return false;
+#endif
+}
+
+
+void cull_set::cull(const frustum &f, std::vector<uint32_t> &visible, cull_path path) {
+    visible.clear();
+
+    if (path == cull_path::best)
+        path = avx_supported() ? cull_path::avx : cull_path::sse;
+
+#if defined(FRUSTUM_CULL_SSE)
+    if (path == cull_path::avx && avx_supported())
+        cull_avx(f, x_.data(), y_.data(), z_.data(), radius_.data(), size_, visible);
+    else if (path != cull_path::scalar)
+        cull_sse(f, x_.data(), y_.data(), z_.data(), radius_.data(), size_, visible);
+    else
+#endif
+    {
+        for (size_t i = 0; i < size_; ++i) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p) {
+                const glm::vec4 &plane = f.planes[p];
+                inside = plane.x * x_[i] + plane.y * y_[i] + plane.z * z_[i] + plane.w >= -radius_[i];
+            }
+
+            if (inside)
+                visible.push_back((uint32_t)i);
+        }
+    }
+
+    stats_.visible = visible.size();
+    stats_.culled = size_ - visible.size();
+}
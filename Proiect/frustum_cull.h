@@ -0,0 +1,65 @@
+#pragma once
+
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* Six planes facing into the frustum, normalized so plane distances are in world units */
+struct frustum {
+    glm::vec4 planes[6];
+};
+
+/* Planes of a view projection matrix, extracted as in Gribb and Hartmann */
+frustum extract_frustum(const glm::mat4 &view_proj);
+
+
+struct cull_stats {
+    size_t visible = 0;
+    size_t culled = 0;
+};
+
+
+/* Implementation cull() runs. best is AVX when the CPU has it and SSE otherwise, the
+ * others are there to compare them. Paths the build or CPU lack fall back to SSE, then scalar. */
+enum class cull_path {
+    best,
+    avx,
+    sse,
+    scalar,
+};
+
+
+/* World space bounding spheres stored as separate x, y, z and radius arrays, so
+ * cull() can test 4 (SSE) or 8 (AVX) spheres against a plane at once. */
+class cull_set {
+public:
+    void clear();
+
+    /* Returns the index cull() reports the sphere under */
+    uint32_t add(glm::vec3 center, float radius);
+
+    /* Bounding sphere of a model space sphere moved by model, scaled by its largest axis */
+    uint32_t add(glm::vec3 center, float radius, const glm::mat4 &model);
+
+    /* Replaces visible with the indices of the spheres touching the frustum, in ascending order */
+    void cull(const frustum &f, std::vector<uint32_t> &visible, cull_path path = cull_path::best);
+
+    /* Checked once, by CPUID and for the OS saving the AVX registers */
+    static bool avx_supported();
+
+    size_t size() const { return size_; }
+
+    const cull_stats &stats() const { return stats_; }
+
+private:
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> z_;
+    std::vector<float> radius_;
+    size_t size_ = 0;
+
+    cull_stats stats_;
+};
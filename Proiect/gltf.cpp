@@ -0,0 +1,522 @@
+#include "gltf.h"
+#include "json.h"
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+
+namespace loader {
+
+static constexpr uint32_t glb_magic = 0x46546C67;
+static constexpr uint32_t glb_json_chunk = 0x4E4F534A;
+static constexpr uint32_t glb_bin_chunk = 0x004E4942;
+
+/* glTF primitive mode of triangle lists, the default */
+static constexpr uint32_t gltf_triangles = 4;
+
+
+static size_t component_size(uint32_t component_type) {
+	switch (component_type) {
+	case gltf_unsigned_byte:
+		return 1;
+	case gltf_unsigned_short:
+		return 2;
+	case gltf_unsigned_int:
+	case gltf_float:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+
+static uint32_t component_count(const std::string &type) {
+	if (type == "SCALAR")
+		return 1;
+	if (type == "VEC2")
+		return 2;
+	if (type == "VEC3")
+		return 3;
+	if (type == "VEC4")
+		return 4;
+
+	return 0;
+}
+
+
+static uint32_t read_u32(const uint8_t *p) {
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+
+size_t gltf_stream::element_size() const {
+	return component_size(component_type) * components;
+}
+
+
+float gltf_stream::component(size_t i, uint32_t c) const {
+	const uint8_t *p = data + i * stride + c * component_size(component_type);
+
+	switch (component_type) {
+	case gltf_unsigned_byte:
+		return normalized ? *p / 255.0f : (float)*p;
+	case gltf_unsigned_short: {
+		uint16_t v;
+		std::memcpy(&v, p, sizeof(v));
+
+		return normalized ? v / 65535.0f : (float)v;
+	}
+	case gltf_unsigned_int:
+		return (float)read_u32(p);
+	default: {
+		float v;
+		std::memcpy(&v, p, sizeof(v));
+
+		return v;
+	}
+	}
+}
+
+
+uint32_t gltf_stream::index(size_t i) const {
+	const uint8_t *p = data + i * stride;
+
+	switch (component_type) {
+	case gltf_unsigned_byte:
+		return *p;
+	case gltf_unsigned_short: {
+		uint16_t v;
+		std::memcpy(&v, p, sizeof(v));
+
+		return v;
+	}
+	default:
+		return read_u32(p);
+	}
+}
+
+
+/* A count, offset or length: absent is 0, anything but a whole number in [0, limit] throws.
+ * The limits keep every sum and product of them inside size_t. */
+static size_t read_size(const std::filesystem::path &path, const json_value &value, const char *name, size_t limit) {
+	if (value.is_null())
+		return 0;
+
+	double number = value.number(-1.0);
+	if (!(number >= 0.0) || number != std::floor(number) || number > (double)limit)
+		throw gltf_error(path, std::string("bad ") + name);
+
+	return (size_t)number;
+}
+
+
+/* Entry of a top level glTF array, the index checked against its size */
+static const json_value &element(const std::filesystem::path &path, const json_value &root, const char *array, const json_value &index) {
+	if (!index.is_number() || index.number() < 0 || index.number() >= root[array].size())
+		throw gltf_error(path, std::string("bad index into ") + array);
+
+	return root[array][(size_t)index.number()];
+}
+
+
+static gltf_stream resolve_accessor(const std::filesystem::path &path, const json_value &root, const json_value &index,
+	const uint8_t *bin, size_t bin_size) {
+	const json_value &accessor = element(path, root, "accessors", index);
+
+	if (!accessor["sparse"].is_null())
+		throw gltf_error(path, "sparse accessors are not supported");
+	if (accessor["bufferView"].is_null())
+		throw gltf_error(path, "accessors without a buffer view are not supported");
+
+	const json_value &view = element(path, root, "bufferViews", accessor["bufferView"]);
+
+	const json_value &buffer = element(path, root, "buffers", view["buffer"]);
+	if (!buffer["uri"].is_null() || !bin)
+		throw gltf_error(path, "only buffers stored in the binary chunk are supported");
+
+	gltf_stream stream;
+	stream.component_type = (uint32_t)read_size(path, accessor["componentType"], "componentType", UINT32_MAX);
+	stream.components = component_count(accessor["type"].string());
+	stream.normalized = accessor["normalized"].boolean();
+
+	if (!stream.element_size())
+		throw gltf_error(path, "unsupported accessor type");
+
+	/* Each bound by what is left of the one before, so none of the sums can wrap */
+	size_t view_offset = read_size(path, view["byteOffset"], "byteOffset", bin_size);
+	size_t view_length = read_size(path, view["byteLength"], "byteLength", bin_size - view_offset);
+	size_t accessor_offset = read_size(path, accessor["byteOffset"], "byteOffset", view_length);
+
+	stream.stride = view["byteStride"].is_null() ? stream.element_size() : read_size(path, view["byteStride"], "byteStride", view_length);
+	if (stream.stride < stream.element_size())
+		throw gltf_error(path, "accessor out of bounds");
+
+	/* Every element takes at least a byte, and the last one has to end inside the view */
+	stream.count = read_size(path, accessor["count"], "count", view_length);
+
+	size_t available = view_length - accessor_offset;
+	if (stream.count && (stream.element_size() > available || stream.count - 1 > (available - stream.element_size()) / stream.stride))
+		throw gltf_error(path, "accessor out of bounds");
+
+	if ((view_offset + accessor_offset) % component_size(stream.component_type) || stream.stride % component_size(stream.component_type))
+		throw gltf_error(path, "misaligned accessor");
+
+	stream.data = bin + view_offset + accessor_offset;
+
+	return stream;
+}
+
+
+static mesh_bounds stream_bounds(const gltf_stream &positions, const glm::mat4 &transform) {
+	if (positions.empty())
+		return mesh_bounds{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, 0.0f };
+
+	auto position = [&](size_t i) {
+		return glm::vec3{ transform * glm::vec4{ positions.component(i, 0), positions.component(i, 1), positions.component(i, 2), 1.0f } };
+	};
+
+	glm::vec3 lo = position(0);
+	glm::vec3 hi = lo;
+	for (size_t i = 1; i < positions.count; ++i) {
+		lo = glm::min(lo, position(i));
+		hi = glm::max(hi, position(i));
+	}
+
+	glm::vec3 center = (lo + hi) * 0.5f;
+
+	float radius_squared = 0.0f;
+	for (size_t i = 0; i < positions.count; ++i) {
+		glm::vec3 d = position(i) - center;
+		radius_squared = std::max(radius_squared, glm::dot(d, d));
+	}
+
+	return mesh_bounds{ lo, hi, center, std::sqrt(radius_squared) };
+}
+
+
+/* matrix when the node has one, translation * rotation * scale otherwise. Each present
+ * property must be an array of as many numbers as it has elements. */
+static glm::mat4 node_matrix(const std::filesystem::path &path, const json_value &node) {
+	auto check = [&](const json_value &array, size_t size, const char *name) {
+		if (array.is_null())
+			return;
+
+		bool valid = array.is_array() && array.size() == size;
+		for (size_t i = 0; valid && i < size; ++i)
+			valid = array[i].is_number();
+
+		if (!valid)
+			throw gltf_error(path, std::string("bad ") + name);
+	};
+
+	const json_value &matrix = node["matrix"];
+	check(matrix, 16, "matrix");
+
+	if (!matrix.is_null()) {
+		glm::mat4 m;
+		for (size_t i = 0; i < 16; ++i)
+			m[i / 4][i % 4] = (float)matrix[i].number();
+
+		return m;
+	}
+
+	/* Missing properties take the identity's */
+	auto element = [](const json_value &array, size_t i, double fallback) {
+		return (float)array[i].number(fallback);
+	};
+
+	const json_value &t = node["translation"];
+	const json_value &r = node["rotation"];
+	const json_value &s = node["scale"];
+
+	check(t, 3, "translation");
+	check(r, 4, "rotation");
+	check(s, 3, "scale");
+
+	glm::vec3 translation{ element(t, 0, 0.0), element(t, 1, 0.0), element(t, 2, 0.0) };
+	glm::quat rotation{ element(r, 3, 1.0), element(r, 0, 0.0), element(r, 1, 0.0), element(r, 2, 0.0) };
+	glm::vec3 scale{ element(s, 0, 1.0), element(s, 1, 1.0), element(s, 2, 1.0) };
+
+	return glm::translate(translation) * glm::mat4_cast(rotation) * glm::scale(scale);
+}
+
+
+gltf_asset::gltf_asset(const std::filesystem::path &path) : file_([&]() {
+	try {
+		return mapped_file{ path };
+	} catch (const mapping_error &) {
+		throw gltf_error(path, "can't map the file");
+	}
+}()) {
+	const uint8_t *data = file_.data();
+	const size_t size = file_.size();
+
+	if (size < 20 || read_u32(data) != glb_magic || read_u32(data + 4) != 2)
+		throw gltf_error(path, "not a glTF 2.0 binary");
+
+	size_t length = std::min<size_t>(read_u32(data + 8), size);
+
+	const char *json_text = nullptr;
+	size_t json_size = 0;
+	const uint8_t *bin = nullptr;
+	size_t bin_size = 0;
+
+	/* Chunks are 4 byte aligned: JSON first, then the optional binary chunk */
+	for (size_t offset = 12; offset + 8 <= length; ) {
+		size_t chunk_size = read_u32(data + offset);
+		uint32_t chunk_type = read_u32(data + offset + 4);
+
+		if (offset + 8 + chunk_size > length)
+			throw gltf_error(path, "truncated chunk");
+
+		if (chunk_type == glb_json_chunk && !json_text) {
+			json_text = (const char *)data + offset + 8;
+			json_size = chunk_size;
+		} else if (chunk_type == glb_bin_chunk && !bin) {
+			bin = data + offset + 8;
+			bin_size = chunk_size;
+		}
+
+		offset += 8 + ((chunk_size + 3) & ~(size_t)3);
+	}
+
+	if (!json_text)
+		throw gltf_error(path, "no JSON chunk");
+
+	json_value root;
+	try {
+		root = parse_json(json_text, json_size);
+	} catch (const json_error &e) {
+		throw gltf_error(path, e.what());
+	}
+
+	const json_value &meshes = root["meshes"];
+
+	/* Primitives of each mesh, placed by the nodes below */
+	std::vector<std::vector<gltf_primitive>> mesh_primitives(meshes.size());
+
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		const json_value &mesh = meshes[m];
+		std::string mesh_name = mesh["name"].is_string() ? mesh["name"].string() : "mesh " + std::to_string(m);
+
+		const json_value &primitives = mesh["primitives"];
+		for (size_t p = 0; p < primitives.size(); ++p) {
+			const json_value &source = primitives[p];
+			const json_value &attributes = source["attributes"];
+
+			size_t mode = source["mode"].is_null() ? gltf_triangles : read_size(path, source["mode"], "mode", UINT32_MAX);
+			if (mode != gltf_triangles || attributes["POSITION"].is_null()) {
+				spdlog::warn("Skipping primitive {} of {} in {}, only triangle lists are drawn", p, mesh_name, path.string());
+				continue;
+			}
+
+			gltf_primitive primitive;
+			primitive.name = mesh_name + "/" + std::to_string(p);
+			primitive.positions = resolve_accessor(path, root, attributes["POSITION"], bin, bin_size);
+
+			if (!attributes["NORMAL"].is_null())
+				primitive.normals = resolve_accessor(path, root, attributes["NORMAL"], bin, bin_size);
+			if (!attributes["TEXCOORD_0"].is_null())
+				primitive.uvs = resolve_accessor(path, root, attributes["TEXCOORD_0"], bin, bin_size);
+			if (!source["indices"].is_null())
+				primitive.indices = resolve_accessor(path, root, source["indices"], bin, bin_size);
+
+			const gltf_stream &positions = primitive.positions;
+			const gltf_stream &normals = primitive.normals;
+			const gltf_stream &uvs = primitive.uvs;
+			const gltf_stream &indices = primitive.indices;
+
+			bool valid = positions.component_type == gltf_float && positions.components == 3
+				&& (normals.empty() || (normals.component_type == gltf_float && normals.components == 3 && normals.count == positions.count))
+				&& (uvs.empty() || (uvs.components == 2 && uvs.count == positions.count
+					&& (uvs.component_type == gltf_float || (uvs.normalized && uvs.component_type != gltf_unsigned_int))))
+				&& (indices.empty() || (indices.components == 1 && indices.component_type != gltf_float));
+			if (!valid)
+				throw gltf_error(path, "unsupported attribute layout in " + primitive.name);
+
+			/* Out of range indices would read past the buffers on the GPU */
+			for (size_t i = 0; i < indices.count; ++i) {
+				if (indices.index(i) >= positions.count)
+					throw gltf_error(path, "index out of range in " + primitive.name);
+			}
+
+			mesh_primitives[m].push_back(std::move(primitive));
+		}
+	}
+
+	/* The loader's space is glTF's with z mirrored, the mirror goes last */
+	const glm::mat4 mirror = glm::scale(glm::vec3{ 1.0f, 1.0f, -1.0f });
+
+	auto place = [&](size_t m, const glm::mat4 &transform, const std::string &node_name) {
+		for (const gltf_primitive &source : mesh_primitives[m]) {
+			gltf_primitive primitive = source;
+			if (!node_name.empty())
+				primitive.name = node_name + ":" + primitive.name;
+
+			primitive.transform = mirror * transform;
+			primitive.bounds = stream_bounds(primitive.positions, primitive.transform);
+
+			primitives_.push_back(std::move(primitive));
+		}
+	};
+
+	const json_value &nodes = root["nodes"];
+
+	/* Files without nodes still get their meshes, where they were modelled */
+	if (!nodes.size()) {
+		for (size_t m = 0; m < meshes.size(); ++m)
+			place(m, glm::mat4{ 1.0f }, "");
+
+		return;
+	}
+
+	/* The nodes have to form a strict tree. A node listed under several parents, or twice
+	 * under one, would be expanded once for every path to it, exponentially many. */
+	std::vector<bool> has_parent(nodes.size(), false);
+	for (size_t n = 0; n < nodes.size(); ++n) {
+		const json_value &children = nodes[n]["children"];
+		for (size_t c = 0; c < children.size(); ++c) {
+			size_t child = read_size(path, children[c], "node", nodes.size() - 1);
+			if (has_parent[child])
+				throw gltf_error(path, "node " + std::to_string(child) + " has more than one parent");
+
+			has_parent[child] = true;
+		}
+	}
+
+	/* With one parent each, reaching a node again means going round a cycle */
+	std::vector<bool> visited(nodes.size(), false);
+
+	std::function<void(size_t, const glm::mat4 &)> visit = [&](size_t n, const glm::mat4 &parent) {
+		if (visited[n])
+			throw gltf_error(path, "cycle in the node hierarchy");
+		visited[n] = true;
+
+		const json_value &node = nodes[n];
+
+		glm::mat4 transform = parent * node_matrix(path, node);
+
+		if (!node["mesh"].is_null()) {
+			if (!meshes.size())
+				throw gltf_error(path, "bad mesh");
+
+			place(read_size(path, node["mesh"], "mesh", meshes.size() - 1), transform,
+				node["name"].is_string() ? node["name"].string() : "node " + std::to_string(n));
+		}
+
+		const json_value &children = node["children"];
+		for (size_t c = 0; c < children.size(); ++c)
+			visit(read_size(path, children[c], "node", nodes.size() - 1), transform);
+	};
+
+	/* The default scene's roots, or every node no other node lists as a child */
+	const json_value &scenes = root["scenes"];
+	if (scenes.size()) {
+		const json_value &scene = scenes[read_size(path, root["scene"], "scene", scenes.size() - 1)];
+		for (size_t r = 0; r < scene["nodes"].size(); ++r) {
+			size_t n = read_size(path, scene["nodes"][r], "node", nodes.size() - 1);
+			if (has_parent[n] || visited[n])
+				throw gltf_error(path, "scene root " + std::to_string(n) + " is not a root node");
+
+			visit(n, glm::mat4{ 1.0f });
+		}
+	} else {
+		for (size_t n = 0; n < nodes.size(); ++n) {
+			if (!has_parent[n])
+				visit(n, glm::mat4{ 1.0f });
+		}
+
+		/* Every node is under some root, unless a cycle has no way in */
+		if (std::find(visited.begin(), visited.end(), false) != visited.end())
+			throw gltf_error(path, "cycle in the node hierarchy");
+	}
+}
+
+
+void append_primitive(const gltf_primitive &primitive, std::vector<vertex> &vertices, std::vector<unsigned int> &indices) {
+	const size_t first = vertices.size();
+	const size_t first_index = indices.size();
+
+	const gltf_stream &positions = primitive.positions;
+	const gltf_stream &normals = primitive.normals;
+	const gltf_stream &uvs = primitive.uvs;
+
+	const glm::mat3 normal_transform = glm::transpose(glm::inverse(glm::mat3{ primitive.transform }));
+
+	for (size_t i = 0; i < positions.count; ++i) {
+		vertex v{
+			glm::vec3{ primitive.transform * glm::vec4{ positions.component(i, 0), positions.component(i, 1), positions.component(i, 2), 1.0f } },
+			glm::vec3{ 0.0f },
+			glm::vec2{ 0.0f },
+		};
+
+		if (!normals.empty()) {
+			v.normal = normal_transform * glm::vec3{ normals.component(i, 0), normals.component(i, 1), normals.component(i, 2) };
+
+			float length = glm::length(v.normal);
+			if (length > 0.0f)
+				v.normal /= length;
+		}
+		if (!uvs.empty())
+			v.uvs = glm::vec2{ uvs.component(i, 0), uvs.component(i, 1) };
+
+		vertices.push_back(v);
+	}
+
+	/* A mirroring transform turns the triangles around, flipping the winding turns them back */
+	bool flip = glm::determinant(glm::mat3{ primitive.transform }) < 0.0f;
+
+	size_t corners = primitive.indices.empty() ? positions.count : primitive.indices.count;
+	for (size_t t = 0; t + 2 < corners; t += 3) {
+		for (size_t c : { (size_t)0, flip ? (size_t)2 : (size_t)1, flip ? (size_t)1 : (size_t)2 }) {
+			size_t index = primitive.indices.empty() ? t + c : primitive.indices.index(t + c);
+			indices.push_back((unsigned int)(first + index));
+		}
+	}
+
+	if (!normals.empty())
+		return;
+
+	for (size_t i = first_index; i + 2 < indices.size(); i += 3) {
+		vertex &a = vertices[indices[i + 0]];
+		vertex &b = vertices[indices[i + 1]];
+		vertex &c = vertices[indices[i + 2]];
+
+		/* Unnormalized, so bigger triangles weigh more */
+		glm::vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+		a.normal += n;
+		b.normal += n;
+		c.normal += n;
+	}
+
+	for (size_t v = first; v < vertices.size(); ++v) {
+		float length = glm::length(vertices[v].normal);
+		if (length > 0.0f)
+			vertices[v].normal /= length;
+	}
+}
+
+
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_glb(const char *path) {
+	gltf_asset asset{ path };
+
+	std::vector<vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	for (const gltf_primitive &primitive : asset.primitives())
+		append_primitive(primitive, vertices, indices);
+
+	if (vertices.empty())
+		throw asset_error(path);
+
+	return std::make_pair(std::move(vertices), std::move(indices));
+}
+
+}
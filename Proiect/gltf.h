@@ -0,0 +1,106 @@
+#pragma once
+
+
+#include "loader.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace loader {
+
+struct gltf_error : public std::exception {
+	gltf_error(const std::filesystem::path &path, const std::string &reason)
+		: message_("Failed to load glTF " + path.string() + ": " + reason) {}
+
+	const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+	std::string message_;
+};
+
+/* Bumped whenever import_glb changes what it produces, it is part of the mesh cache key */
+constexpr uint32_t gltf_loader_version = 2;
+
+/* glTF component types, which are the GL enums of the same name */
+constexpr uint32_t gltf_unsigned_byte = 5121;
+constexpr uint32_t gltf_unsigned_short = 5123;
+constexpr uint32_t gltf_unsigned_int = 5125;
+constexpr uint32_t gltf_float = 5126;
+
+/* An accessor resolved to the bytes it covers in the mapped file */
+struct gltf_stream {
+	const uint8_t *data = nullptr;
+	size_t count = 0;
+	/* Bytes from one element to the next, the element size when tightly packed */
+	size_t stride = 0;
+	uint32_t component_type = 0;
+	uint32_t components = 0;
+	bool normalized = false;
+
+	bool empty() const { return !count; }
+
+	size_t element_size() const;
+
+	/* Bytes from the start of the first element to the end of the last */
+	size_t span() const { return count ? (count - 1) * stride + element_size() : 0; }
+
+	/* Component c of element i converted to float, normalized integers mapped to [0, 1] */
+	float component(size_t i, uint32_t c) const;
+
+	/* Element i of an index stream */
+	uint32_t index(size_t i) const;
+};
+
+/* One triangle primitive of a mesh. Positions are float triples, normals float triples
+ * when present, uvs float, normalized byte or normalized short pairs when present.
+ * Without indices the primitive is drawn unindexed. */
+struct gltf_primitive {
+	std::string name;
+
+	gltf_stream positions;
+	gltf_stream normals;
+	gltf_stream uvs;
+	gltf_stream indices;
+
+	/* The node transforms down to the primitive, then the z mirror from glTF's right handed
+	 * space into the loader's left handed one. A mesh placed by several nodes is listed once
+	 * for each, sharing the streams. */
+	glm::mat4 transform{ 1.0f };
+
+	/* Of the positions after transform */
+	mesh_bounds bounds;
+};
+
+/* A .glb file mapped into memory, its primitives point straight into the binary chunk.
+ * The primitives are those the default scene's nodes place, or every root node's when
+ * there are no scenes, and every mesh's as modelled when there are no nodes. Buffers
+ * outside the file and sparse accessors are not supported. */
+class gltf_asset {
+public:
+	explicit gltf_asset(const std::filesystem::path &path);
+
+	gltf_asset(const gltf_asset &other) = delete;
+	gltf_asset &operator=(const gltf_asset &other) = delete;
+
+	gltf_asset(gltf_asset &&other) noexcept = default;
+	gltf_asset &operator=(gltf_asset &&other) noexcept = default;
+
+	const std::vector<gltf_primitive> &primitives() const { return primitives_; }
+
+private:
+	mapped_file file_;
+	std::vector<gltf_primitive> primitives_;
+};
+
+/* Copies the primitive into the loader's vertex layout with its transform applied, the
+ * winding flipped back when the transform mirrors. Missing normals are generated smooth. */
+void append_primitive(const gltf_primitive &primitive, std::vector<vertex> &vertices, std::vector<unsigned int> &indices);
+
+/* Every primitive of the file merged into one mesh, for load_asset */
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_glb(const char *path);
+
+}
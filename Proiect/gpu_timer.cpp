@@ -0,0 +1,160 @@
+#include "gpu_timer.h"
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+
+gpu_timer::gpu_timer() {
+    if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) {
+        /* Drivers may expose the entry points with a zero bit counter */
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        supported_ = bits > 0;
+    }
+
+    if (!supported_)
+        spdlog::warn("No timestamp queries, GPU pass times are unavailable");
+
+    frame_history_.path = "frame";
+}
+
+
+uint32_t gpu_timer::timestamp() {
+    frame_slot &slot = slots_[current_];
+
+    if (slot.used == slot.queries.size())
+        slot.queries.emplace_back(gen_query());
+
+    uint32_t query = (uint32_t)slot.used++;
+    glQueryCounter(slot.queries[query].get(), GL_TIMESTAMP);
+
+    return query;
+}
+
+
+void gpu_timer::begin_frame() {
+    resolved_ = false;
+
+    if (!supported_)
+        return;
+
+    current_ = frame_++ % n_frames;
+    frame_slot &slot = slots_[current_];
+
+    if (slot.used)
+        read_back(slot);
+
+    slot.used = 0;
+    slot.sections.clear();
+    open_.clear();
+}
+
+
+void gpu_timer::begin(const char *name) {
+    if (!supported_)
+        return;
+
+    frame_slot &slot = slots_[current_];
+
+    uint32_t parent = open_.empty() ? no_parent : open_.back();
+    uint32_t depth = (uint32_t)open_.size();
+
+    open_.push_back((uint32_t)slot.sections.size());
+    slot.sections.push_back({ name, parent, depth, timestamp(), no_parent });
+}
+
+
+void gpu_timer::end() {
+    if (!supported_ || open_.empty())
+        return;
+
+    slots_[current_].sections[open_.back()].end_query = timestamp();
+    open_.pop_back();
+}
+
+
+void gpu_timer::read_back(frame_slot &slot) {
+    /* Checking is free, only reading a pending result would wait */
+    for (size_t i = 0; i < slot.used; ++i) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(slot.queries[i].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available) {
+            ++frames_dropped_;
+            return;
+        }
+    }
+
+    std::vector<GLuint64> times(slot.used);
+    for (size_t i = 0; i < slot.used; ++i)
+        glGetQueryObjectui64v(slot.queries[i].get(), GL_QUERY_RESULT, &times[i]);
+
+    auto [first, last] = std::minmax_element(times.begin(), times.end());
+    frame_ms_ = (*last - *first) * 1e-6;
+    frame_history_.times.add((float)frame_ms_, spike_factor);
+
+    sections_.clear();
+    std::vector<std::string> paths(slot.sections.size());
+
+    for (size_t i = 0; i < slot.sections.size(); ++i) {
+        const section &s = slot.sections[i];
+
+        paths[i] = s.parent == no_parent ? s.name : paths[s.parent] + " / " + s.name;
+
+        /* Never ended, the end has nothing to pair with */
+        if (s.end_query == no_parent)
+            continue;
+
+        double ms = (times[s.end_query] - times[s.begin_query]) * 1e-6;
+        sections_.push_back({ paths[i], s.depth, ms });
+
+        auto h = std::find_if(history_.begin(), history_.end(), [&](const section_history &h) { return h.path == paths[i]; });
+        if (h == history_.end()) {
+            history_.emplace_back();
+            history_.back().path = paths[i];
+            h = history_.end() - 1;
+        }
+
+        h->times.add((float)ms, spike_factor);
+    }
+
+    resolved_ = true;
+}
+
+
+void gpu_timer::draw_table() const {
+    if (!supported_) {
+        ImGui::Text("GPU times need timestamp queries");
+        return;
+    }
+
+    ImGui::Text("GPU frame %.3f ms, avg %.3f ms, %zu frames dropped", frame_ms_, frame_history_.times.avg_ms, frames_dropped_);
+
+    ImGui::Columns(4, "gpu sections");
+    for (const char *heading : { "section", "last ms", "avg ms", "max ms" }) {
+        ImGui::Text("%s", heading);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+
+    for (const gpu_section_time &s : sections_) {
+        auto h = std::find_if(history_.begin(), history_.end(), [&](const section_history &h) { return h.path == s.path; });
+
+        /* The name alone, indented by depth, the tooltip has the whole path */
+        size_t name = s.path.rfind(" / ");
+        const char *label = name == std::string::npos ? s.path.c_str() : s.path.c_str() + name + 3;
+        if (h->times.spiked)
+            ImGui::TextColored(ImVec4{ 0.9f, 0.2f, 0.2f, 1.0f }, "%*s%s", (int)(2 * s.depth), "", label);
+        else
+            ImGui::Text("%*s%s", (int)(2 * s.depth), "", label);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("%s", s.path.c_str());
+        ImGui::NextColumn();
+
+        for (float value : { (float)s.ms, h->times.avg_ms, h->times.max_ms }) {
+            ImGui::Text("%.3f", value);
+            ImGui::NextColumn();
+        }
+    }
+    ImGui::Columns(1);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include "profiler.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/* GPU time of a section of a read back frame. path is the section's name after the
+ * names of the sections around it, "opaque pass / ferrari". */
+struct gpu_section_time {
+    std::string path;
+    uint32_t depth;
+    double ms;
+};
+
+
+/* Times sections of the frame on the GPU with a GL_TIMESTAMP query at each begin and end,
+ * so sections can nest, which GL_TIME_ELAPSED queries can't. Each frame has its own slot of
+ * queries in a ring of n_frames and is read back when its slot comes round again. By then
+ * the GPU is long done with it; if it still isn't, the frame is dropped rather than waited for. */
+class gpu_timer {
+public:
+    static constexpr size_t n_frames = 4;
+    static constexpr size_t history_frames = scope_history::history_frames;
+
+    /* Needs a current context. Without timestamp queries every call does nothing. */
+    gpu_timer();
+
+    gpu_timer(const gpu_timer &other) = delete;
+    gpu_timer &operator=(const gpu_timer &other) = delete;
+
+    bool supported() const { return supported_; }
+
+    /* Reads back the frame that last used the slot and starts recording into it */
+    void begin_frame();
+
+    /* name has to outlive the timer, string literals do. Every begin needs an end. */
+    void begin(const char *name);
+    void end();
+
+    /* Whether the last begin_frame read a frame back. The results below stay those of
+     * the last frame read back until the next one is. */
+    bool resolved() const { return resolved_; }
+
+    /* From the first timestamp of the frame to its last */
+    double frame_ms() const { return frame_ms_; }
+
+    /* In the order the sections began */
+    const std::vector<gpu_section_time> &sections() const { return sections_; }
+
+    size_t frames_dropped() const { return frames_dropped_; }
+
+    /* Table of the last frame's sections with their rolling avg / max. Sections over
+     * spike_factor times their average are drawn red, as in the profiler window. */
+    void draw_table() const;
+
+    float spike_factor = scope_history::default_spike_factor;
+
+private:
+    static constexpr uint32_t no_parent = ~0u;
+
+    struct section {
+        const char *name;
+        uint32_t parent;
+        uint32_t depth;
+        uint32_t begin_query;
+        uint32_t end_query;
+    };
+
+    struct frame_slot {
+        std::vector<query_t> queries;
+        size_t used = 0;
+        std::vector<section> sections;
+    };
+
+    struct section_history {
+        std::string path;
+        scope_history times;
+    };
+
+    /* Issues a timestamp query from the current slot, growing it as needed */
+    uint32_t timestamp();
+
+    void read_back(frame_slot &slot);
+
+    bool supported_ = false;
+
+    std::array<frame_slot, n_frames> slots_;
+    size_t frame_ = 0;
+    size_t current_ = 0;
+
+    /* Sections of the current slot begun but not ended yet */
+    std::vector<uint32_t> open_;
+
+    bool resolved_ = false;
+    double frame_ms_ = 0.0;
+    std::vector<gpu_section_time> sections_;
+    size_t frames_dropped_ = 0;
+
+    section_history frame_history_;
+    std::vector<section_history> history_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/* 64 bit FNV-1a, used to key the on-disk caches. Pass the previous result as
+ * seed to hash several pieces as one. */
+constexpr uint64_t fnv_offset_basis = 14695981039346656037ull;
+
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = fnv_offset_basis) {
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+inline uint64_t hash_string(const std::string &s, uint64_t seed = fnv_offset_basis) {
+    return hash_bytes(s.data(), s.size(), seed);
+}
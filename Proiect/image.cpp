@@ -0,0 +1,17 @@
+#include "image.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+image_data decode_image(const std::string &path, bool flip) {
+    /* The global flag would race with decodes on other threads */
+    stbi_set_flip_vertically_on_load_thread(flip);
+
+    int width, height, channels;
+    unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (!pixels)
+        throw image_error(path, stbi_failure_reason());
+
+    return image_data{ { pixels, stbi_image_free }, width, height, channels };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+
+struct image_error : public std::exception {
+    image_error(const std::string &path, const char *reason)
+        : message_("Failed to decode image " + path + ": " + (reason ? reason : "unknown error")) {}
+
+    const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+    std::string message_;
+};
+
+
+/* Decoded 8 bit pixels, rows tightly packed */
+struct image_data {
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels;
+
+    int width;
+    int height;
+    int channels;
+};
+
+
+/* Safe to call from any thread, the flip only applies to this decode */
+image_data decode_image(const std::string &path, bool flip);
@@ -0,0 +1,135 @@
+#include "instancing.h"
+#include <algorithm>
+#include <cstddef>
+
+
+instance_batch::instance_batch() : buffer_(gen_buffer()) {}
+
+
+void instance_batch::point_attributes(size_t first) const {
+    const size_t base = first * sizeof(instance_data);
+
+    uint32_t location = first_location;
+
+    for (int i = 0; i < 4; ++i, ++location) {
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(instance_data),
+            (const void *)(base + offsetof(instance_data, model) + i * sizeof(glm::vec4)));
+    }
+
+    for (int i = 0; i < 3; ++i, ++location) {
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(instance_data),
+            (const void *)(base + offsetof(instance_data, normal) + i * sizeof(glm::vec3)));
+    }
+
+    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(instance_data),
+        (const void *)(base + offsetof(instance_data, color)));
+}
+
+
+void instance_batch::attach(const gpu_mesh &mesh) {
+    dequantize_ = mesh.dequantize;
+    normal_dequantize_ = mesh.normal_dequantize;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_.get());
+
+    /* The depth VAO only reads the model matrix, the other pointers are set but stay disabled */
+    for (uint32_t vao : { mesh.depth_vao.get(), mesh.vao.get() }) {
+        glBindVertexArray(vao);
+
+        uint32_t end = vao == mesh.vao.get() ? first_location + 8 : first_location + 4;
+        for (uint32_t location = first_location; location < end; ++location) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+
+        point_attributes(0);
+    }
+}
+
+
+void instance_batch::clear() {
+    for (auto &instances : lods_)
+        instances.clear();
+}
+
+
+void instance_batch::push(const glm::mat4 &model, glm::vec3 color) {
+    /* Normals are decoded in model space, so they don't see the dequantize scale */
+    lods_[0].push_back({ model * dequantize_, glm::transpose(glm::inverse(glm::mat3(model))) * normal_dequantize_, color });
+}
+
+
+void instance_batch::push(const glm::mat4 &model, const glm::mat3 &normal, glm::vec3 color, uint32_t lod) {
+    lods_[std::min<size_t>(lod, lods_.size() - 1)].push_back({ model * dequantize_, normal * normal_dequantize_, color });
+}
+
+
+void instance_batch::upload() {
+    size_t total = size();
+    if (!total)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_.get());
+
+    /* Orphan the previous store so the driver doesn't wait on draws still reading it */
+    capacity_ = std::max(capacity_, total);
+    glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(instance_data), NULL, GL_STREAM_DRAW);
+
+    size_t first = 0;
+    for (size_t lod = 0; lod < lods_.size(); ++lod) {
+        first_[lod] = first;
+
+        if (!lods_[lod].empty())
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(instance_data), lods_[lod].size() * sizeof(instance_data), lods_[lod].data());
+
+        first += lods_[lod].size();
+    }
+}
+
+
+void instance_batch::draw(const gpu_mesh &mesh) const {
+    draw(mesh, 0, mesh.submeshes.size());
+}
+
+
+void instance_batch::draw(const gpu_mesh &mesh, size_t first_submesh, size_t submesh_count) const {
+    const size_t index_size = mesh.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    bool rebased = false;
+
+    for (size_t lod = 0; lod < lods_.size(); ++lod) {
+        if (lods_[lod].empty())
+            continue;
+
+        /* Every level past the first has its instances further into the buffer */
+        if (first_[lod] != 0) {
+            if (!rebased)
+                glBindBuffer(GL_ARRAY_BUFFER, buffer_.get());
+
+            point_attributes(first_[lod]);
+            rebased = true;
+        }
+
+        GLsizei count = (GLsizei)lods_[lod].size();
+
+        if (!mesh.submeshes.empty()) {
+            /* Scenes have no levels of detail, each submesh is drawn whole */
+            for (size_t i = first_submesh; i < first_submesh + submesh_count; ++i) {
+                const loader::submesh &part = mesh.submeshes[i];
+
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, part.index_count, mesh.index_type,
+                    (const void *)(part.first_index * index_size), count, part.base_vertex);
+            }
+        } else if (mesh.index_count) {
+            const loader::mesh_lod &range = mesh.lods[std::min(lod, mesh.lods.size() - 1)];
+
+            glDrawElementsInstanced(GL_TRIANGLES, range.index_count, mesh.index_type,
+                (const void *)(range.index_offset * index_size), count);
+        } else {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.vertex_count, count);
+        }
+    }
+
+    if (rebased)
+        point_attributes(0);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+/* Per instance attributes, read by vertex.glsl from locations 3 to 10 */
+struct instance_data {
+    glm::mat4 model;
+    glm::mat3 normal;
+    glm::vec3 color;
+};
+
+
+/* Instances of one mesh, drawn with a single instanced call.
+ *
+ * The batch owns a per-instance vertex buffer; attach() points the instance
+ * attributes of a mesh's VAOs at it, so each mesh can be fed by exactly one batch.
+ * Pushed model and normal matrices get the mesh's dequantize matrices folded in. */
+class instance_batch {
+public:
+    static constexpr uint32_t first_location = 3;
+
+    instance_batch();
+
+    instance_batch(const instance_batch &other) = delete;
+    instance_batch &operator=(const instance_batch &other) = delete;
+
+    void attach(const gpu_mesh &mesh);
+
+    void clear();
+
+    void push(const glm::mat4 &model, glm::vec3 color = glm::vec3{ 1.0f });
+
+    /* With a normal matrix already at hand, as transform_batch computes them, drawn
+     * with the mesh's level of detail lod */
+    void push(const glm::mat4 &model, const glm::mat3 &normal, glm::vec3 color = glm::vec3{ 1.0f }, uint32_t lod = 0);
+
+    /* Sends the instances pushed since the last clear() to the GPU */
+    void upload();
+
+    /* Draws the mesh attach() was called with, its VAO or depth VAO has to be bound.
+     * One instanced call per level of detail in use, or per submesh for scenes. */
+    void draw(const gpu_mesh &mesh) const;
+
+    /* Only submesh_count submeshes of a scene from first_submesh on, so materials can be bound in between */
+    void draw(const gpu_mesh &mesh, size_t first_submesh, size_t submesh_count) const;
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto &instances : lods_)
+            total += instances.size();
+
+        return total;
+    }
+
+    size_t size(uint32_t lod) const { return lods_[lod].size(); }
+
+private:
+    /* Points the instance attributes of the bound VAO at the buffer, starting from instance first */
+    void point_attributes(size_t first) const;
+
+    buffer_t buffer_;
+    glm::mat4 dequantize_{ 1.0f };
+    glm::mat3 normal_dequantize_{ 1.0f };
+
+    /* Instances by level of detail, stored one level after the other in the buffer */
+    std::array<std::vector<instance_data>, loader::max_lods> lods_;
+    std::array<size_t, loader::max_lods> first_{};
+    size_t capacity_ = 0;
+};
@@ -0,0 +1,288 @@
+#include "json.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+/* Nesting deeper than this is rejected before it can exhaust the stack */
+static constexpr int max_json_depth = 256;
+
+
+static const json_value &null_value() {
+    static const json_value value;
+
+    return value;
+}
+
+
+const json_value &json_value::operator[](size_t index) const {
+    if (type_ != type::array || index >= elements_.size())
+        return null_value();
+
+    return elements_[index];
+}
+
+
+const json_value &json_value::operator[](const char *key) const {
+    if (type_ != type::object)
+        return null_value();
+
+    for (const auto &member : members_) {
+        if (member.first == key)
+            return member.second;
+    }
+
+    return null_value();
+}
+
+
+class json_parser {
+public:
+    json_parser(const char *text, size_t size) : begin_(text), p_(text), end_(text + size) {}
+
+    json_value parse_document() {
+        json_value value = parse_value(0);
+
+        skip_space();
+        if (p_ != end_)
+            fail("trailing characters");
+
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const char *reason) const {
+        throw json_error(reason, (size_t)(p_ - begin_));
+    }
+
+    void skip_space() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            ++p_;
+    }
+
+    void expect(const char *literal) {
+        size_t length = std::strlen(literal);
+        if ((size_t)(end_ - p_) < length || std::memcmp(p_, literal, length) != 0)
+            fail("unexpected token");
+
+        p_ += length;
+    }
+
+    json_value parse_value(int depth) {
+        if (depth > max_json_depth)
+            fail("nested too deep");
+
+        skip_space();
+        if (p_ == end_)
+            fail("unexpected end");
+
+        json_value value;
+
+        switch (*p_) {
+        case '{':
+            value.type_ = json_value::type::object;
+            ++p_;
+
+            skip_space();
+            if (p_ < end_ && *p_ == '}') {
+                ++p_;
+                break;
+            }
+
+            for (;;) {
+                skip_space();
+                if (p_ == end_ || *p_ != '"')
+                    fail("expected a key");
+
+                std::string key = parse_string();
+
+                skip_space();
+                if (p_ == end_ || *p_ != ':')
+                    fail("expected ':'");
+                ++p_;
+
+                value.members_.emplace_back(std::move(key), parse_value(depth + 1));
+
+                skip_space();
+                if (p_ < end_ && *p_ == ',') {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == '}') {
+                    ++p_;
+                    break;
+                }
+
+                fail("expected ',' or '}'");
+            }
+            break;
+
+        case '[':
+            value.type_ = json_value::type::array;
+            ++p_;
+
+            skip_space();
+            if (p_ < end_ && *p_ == ']') {
+                ++p_;
+                break;
+            }
+
+            for (;;) {
+                value.elements_.push_back(parse_value(depth + 1));
+
+                skip_space();
+                if (p_ < end_ && *p_ == ',') {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == ']') {
+                    ++p_;
+                    break;
+                }
+
+                fail("expected ',' or ']'");
+            }
+            break;
+
+        case '"':
+            value.type_ = json_value::type::string;
+            value.string_ = parse_string();
+            break;
+
+        case 't':
+            expect("true");
+            value.type_ = json_value::type::boolean;
+            value.boolean_ = true;
+            break;
+
+        case 'f':
+            expect("false");
+            value.type_ = json_value::type::boolean;
+            break;
+
+        case 'n':
+            expect("null");
+            break;
+
+        default:
+            value.type_ = json_value::type::number;
+            value.number_ = parse_number();
+            break;
+        }
+
+        return value;
+    }
+
+    double parse_number() {
+        /* strtod would read past the end of an unterminated buffer, so the token is copied out first */
+        const char *start = p_;
+        while (p_ < end_ && ((*p_ >= '0' && *p_ <= '9') || *p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' || *p_ == 'E'))
+            ++p_;
+
+        std::string token{ start, p_ };
+        if (token.empty())
+            fail("unexpected character");
+
+        char *parsed_end;
+        double number = std::strtod(token.c_str(), &parsed_end);
+        if (parsed_end != token.c_str() + token.size())
+            fail("malformed number");
+
+        return number;
+    }
+
+    void append_utf8(std::string &out, uint32_t code) {
+        if (code < 0x80) {
+            out += (char)code;
+        } else if (code < 0x800) {
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        } else {
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    uint32_t parse_hex4() {
+        if (end_ - p_ < 4)
+            fail("truncated escape");
+
+        uint32_t code = 0;
+        for (int i = 0; i < 4; ++i, ++p_) {
+            char c = *p_;
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+                code |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                fail("bad escape");
+        }
+
+        return code;
+    }
+
+    std::string parse_string() {
+        ++p_;
+
+        std::string out;
+        for (;;) {
+            const char *run = p_;
+            while (p_ < end_ && *p_ != '"' && *p_ != '\\')
+                ++p_;
+            out.append(run, p_);
+
+            if (p_ == end_)
+                fail("unterminated string");
+
+            if (*p_++ == '"')
+                return out;
+
+            if (p_ == end_)
+                fail("unterminated string");
+
+            switch (*p_++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t code = parse_hex4();
+
+                /* Surrogate pair */
+                if (code >= 0xD800 && code < 0xDC00 && end_ - p_ >= 2 && p_[0] == '\\' && p_[1] == 'u') {
+                    p_ += 2;
+                    uint32_t low = parse_hex4();
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                fail("bad escape");
+            }
+        }
+    }
+
+    const char *begin_;
+    const char *p_;
+    const char *end_;
+};
+
+
+json_value parse_json(const char *text, size_t size) {
+    return json_parser{ text, size }.parse_document();
+}
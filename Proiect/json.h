@@ -0,0 +1,64 @@
+#pragma once
+
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+struct json_error : public std::exception {
+    json_error(const std::string &reason, size_t offset)
+        : message_("Invalid JSON at byte " + std::to_string(offset) + ": " + reason) {}
+
+    const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+    std::string message_;
+};
+
+
+/* Parsed JSON document node. Lookups of missing keys and indices, or with
+ * the wrong type, give a null value instead of throwing, so optional fields
+ * read naturally: value["bufferView"].is_null(). */
+class json_value {
+public:
+    enum class type { null, boolean, number, string, array, object };
+
+    json_value() = default;
+
+    type kind() const { return type_; }
+    bool is_null() const { return type_ == type::null; }
+    bool is_number() const { return type_ == type::number; }
+    bool is_string() const { return type_ == type::string; }
+    bool is_array() const { return type_ == type::array; }
+    bool is_object() const { return type_ == type::object; }
+
+    bool boolean(bool fallback = false) const { return type_ == type::boolean ? boolean_ : fallback; }
+    double number(double fallback = 0.0) const { return type_ == type::number ? number_ : fallback; }
+    const std::string &string() const { return string_; }
+
+    /* Elements of an array, members of an object */
+    size_t size() const { return type_ == type::array ? elements_.size() : type_ == type::object ? members_.size() : 0; }
+
+    const json_value &operator[](size_t index) const;
+    const json_value &operator[](const char *key) const;
+
+    const std::vector<json_value> &elements() const { return elements_; }
+    const std::vector<std::pair<std::string, json_value>> &members() const { return members_; }
+
+private:
+    friend class json_parser;
+
+    type type_ = type::null;
+    bool boolean_ = false;
+    double number_ = 0.0;
+    std::string string_;
+    std::vector<json_value> elements_;
+    std::vector<std::pair<std::string, json_value>> members_;
+};
+
+
+/* Parses a whole UTF-8 document, throws json_error */
+json_value parse_json(const char *text, size_t size);
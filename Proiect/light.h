@@ -2,57 +2,35 @@
 
 
 #include <glm/glm.hpp>
-#include <cstdint>
-#include <string>
-#include <GL/glew.h>
+#include <cmath>
+#include <limits>
 
 
 class light {
 public:
-    light (uint32_t program, std::string name, glm::vec3 position = glm::vec3(0.0f), glm::vec3 color = glm::vec3(1.0f))
-        : program(program), name(name), position(position), ambient(0.3f), color(color), constant(2.0f), linear(0.2f), quadratic(0.01f) {
-        position_loc = get_location(program, (name + ".position").c_str());
+    light (glm::vec3 position = glm::vec3(0.0f), glm::vec3 color = glm::vec3(1.0f))
+        : position(position), ambient(0.3f), color(color), constant(2.0f), linear(0.2f), quadratic(0.01f) {}
 
-        ambient_loc = get_location(program, (name + ".ambient").c_str());
+    /* Distance past which the light contributes less than threshold to any channel.
+     * Solves constant + linear * d + quadratic * d^2 = peak / threshold, where peak is the
+     * brightest value calculate_point_light can return (ambient + diffuse + specular). */
+    float radius(float threshold) const {
+        float peak = (glm::max(ambient.x, glm::max(ambient.y, ambient.z)) + 2.0f)
+            * glm::max(color.r, glm::max(color.g, color.b));
 
-        constant_loc = get_location(program, (name + ".constant").c_str());
-        linear_loc = get_location(program, (name + ".linear").c_str());
-        quadratic_loc = get_location(program, (name + ".quadratic").c_str());
+        float c = constant - peak / threshold;
+        if (c >= 0.0f)
+            return 0.0f;
 
-        color_loc = get_location(program, (name + ".color").c_str());
+        if (quadratic > 0.0f)
+            return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
 
-        light_color_location = get_location(program, "u_light_color");
-    }
-
-    void update() {
-        glUseProgram(program);
-
-        glUniform3fv(position_loc, 1, glm::value_ptr(position));
-
-        glUniform3fv(ambient_loc, 1, glm::value_ptr(ambient));
+        if (linear > 0.0f)
+            return -c / linear;
 
-        glUniform3fv(color_loc, 1, glm::value_ptr(color));
-
-        glUniform1f(constant_loc, constant);
-        glUniform1f(linear_loc, linear);
-        glUniform1f(quadratic_loc, quadratic);
+        return std::numeric_limits<float>::infinity();
     }
 
-    void draw(int model_location) {
-        glUseProgram(program);
-
-        glUniform3fv(light_color_location, 1, glm::value_ptr(color));
-
-        auto model = glm::translate(position) * glm::scale(glm::vec3{ 0.2f });
-
-        glUniformMatrix4fv(model_location, 1, GL_FALSE, glm::value_ptr(model));
-
-        glDrawArrays(GL_TRIANGLES, 0, n_vertices);
-    }
-
-    const uint32_t program;
-    const std::string name;
-
     glm::vec3 position;
     glm::vec3 ambient;
     glm::vec3 color;
@@ -60,13 +38,4 @@ public:
     float constant;
     float linear;
     float quadratic;
-
-private:
-    int position_loc;
-    int ambient_loc;
-    int constant_loc;
-    int linear_loc;
-    int quadratic_loc;
-    int color_loc;
-    int light_color_location;
 };
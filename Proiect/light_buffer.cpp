@@ -0,0 +1,145 @@
+#include "light_buffer.h"
+#include "light.h"
+#include "shader.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+
+/* Clean lights between two dirty ones are sent along with them when the gap
+ * is at most this long, one bigger upload is cheaper than another call */
+static constexpr size_t max_clean_gap = 4;
+
+
+static packed_light pack(const light &l) {
+    packed_light result{};
+
+    result.position = l.position;
+    result.color = l.color;
+    result.ambient = l.ambient;
+    result.constant = l.constant;
+    result.linear = l.linear;
+    result.quadratic = l.quadratic;
+
+    return result;
+}
+
+
+light_buffer::light_buffer() : buffer_(gen_buffer()) {}
+
+
+void light_buffer::setup_program(uint32_t program, uint32_t binding) {
+    binding_ = binding;
+
+    bool storage = false;
+
+    if (GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query) {
+        GLuint index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "light_block");
+        if (index != GL_INVALID_INDEX) {
+            glShaderStorageBlockBinding(program, index, binding);
+            storage = true;
+        }
+    }
+
+    if (!storage) {
+        GLuint index = glGetUniformBlockIndex(program, "light_block");
+        if (index == GL_INVALID_INDEX)
+            throw gl_uniform_not_found_exception("light_block");
+
+        glUniformBlockBinding(program, index, binding);
+    }
+
+    /* Every variant of a shader gets the same kind of block, only the first call switches */
+    if (storage != storage_ || !configured_) {
+        spdlog::info("Lights are stored in a {} buffer", storage ? "shader storage" : "uniform");
+
+        storage_ = storage;
+        configured_ = true;
+
+        /* The store is reallocated on the next update */
+        capacity_ = 0;
+    }
+}
+
+
+void light_buffer::reserve(size_t count) {
+    capacity_ = storage_ ? std::max({ count, 2 * capacity_, (size_t)64 }) : max_uniform_lights;
+
+    GLenum target = storage_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+
+    glBindBuffer(target, buffer_.get());
+    glBufferData(target, capacity_ * sizeof(packed_light), NULL, GL_DYNAMIC_DRAW);
+    stats_.gl_calls += 2;
+
+    /* Nothing in the new store is valid, every light is uploaded again */
+    size_ = 0;
+}
+
+
+void light_buffer::update(const std::vector<light> &lights) {
+    stats_ = light_buffer_stats{};
+
+    size_t count = lights.size();
+    if (!storage_ && count > max_uniform_lights) {
+        if (!truncated_)
+            spdlog::warn("Only the first {} of {} lights fit in the uniform buffer", max_uniform_lights, count);
+
+        count = max_uniform_lights;
+    }
+    truncated_ = count < lights.size();
+
+    if (count > capacity_)
+        reserve(count);
+
+    mirror_.resize(std::max(mirror_.size(), count));
+    dirty_.resize(mirror_.size(), false);
+
+    for (size_t i = 0; i < count; ++i) {
+        packed_light packed = pack(lights[i]);
+
+        if (i >= size_ || std::memcmp(&packed, &mirror_[i], sizeof(packed)) != 0) {
+            mirror_[i] = packed;
+            dirty_[i] = true;
+            ++stats_.dirty_lights;
+        }
+    }
+
+    size_ = count;
+
+    if (!stats_.dirty_lights)
+        return;
+
+    GLenum target = storage_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+
+    glBindBuffer(target, buffer_.get());
+    ++stats_.gl_calls;
+
+    size_t i = 0;
+    while (i < size_) {
+        if (!dirty_[i]) {
+            ++i;
+            continue;
+        }
+
+        size_t begin = i;
+        size_t end = i + 1;
+        for (size_t j = end; j < size_ && j - end < max_clean_gap; ++j) {
+            if (dirty_[j])
+                end = j + 1;
+        }
+
+        glBufferSubData(target, begin * sizeof(packed_light), (end - begin) * sizeof(packed_light), &mirror_[begin]);
+        ++stats_.gl_calls;
+        stats_.bytes_uploaded += (end - begin) * sizeof(packed_light);
+
+        std::fill(dirty_.begin() + begin, dirty_.begin() + end, false);
+
+        i = end;
+    }
+}
+
+
+void light_buffer::bind() {
+    glBindBufferBase(storage_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER, binding_, buffer_.get());
+    ++stats_.gl_calls;
+}
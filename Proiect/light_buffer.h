@@ -0,0 +1,79 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+
+class light;
+
+
+/* Layout of point_light in the light_block of fragment.glsl, identical under std140 and std430 */
+struct packed_light {
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 color;
+    float pad1;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad2[2];
+};
+
+static_assert(sizeof(packed_light) == 64, "packed_light must match the std140 layout of point_light");
+
+
+struct light_buffer_stats {
+    size_t dirty_lights = 0;
+    size_t bytes_uploaded = 0;
+    size_t gl_calls = 0;
+};
+
+
+/* Keeps a CPU mirror of every light packed the way the shader reads it and only
+ * uploads the lights that changed since the last frame. Backed by a shader storage
+ * buffer when the driver has them and by a uniform buffer of max_uniform_lights otherwise. */
+class light_buffer {
+public:
+    static constexpr size_t max_uniform_lights = 256;
+
+    light_buffer();
+
+    light_buffer(const light_buffer &other) = delete;
+    light_buffer &operator=(const light_buffer &other) = delete;
+
+    /* Picks the block kind the program was compiled with and binds its light_block to binding.
+     * Can be called for several programs, they all have to use the same kind. */
+    void setup_program(uint32_t program, uint32_t binding);
+
+    /* Packs the lights, diffs them against the mirror and uploads the changed ranges */
+    void update(const std::vector<light> &lights);
+
+    void bind();
+
+    bool storage() const { return storage_; }
+
+    size_t size() const { return size_; }
+
+    const light_buffer_stats &stats() const { return stats_; }
+
+private:
+    void reserve(size_t count);
+
+    buffer_t buffer_;
+
+    bool storage_ = false;
+    bool configured_ = false;
+    uint32_t binding_ = 0;
+
+    std::vector<packed_light> mirror_;
+    std::vector<bool> dirty_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    bool truncated_ = false;
+
+    light_buffer_stats stats_;
+};
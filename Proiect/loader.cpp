@@ -2,35 +2,95 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "loader.h"
+#include "mesh_cache.h"
+#include "weld.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "obj_parser.h"
+#include "gltf.h"
+#include "scene_import.h"
+#include "hash.h"
 #include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 
 
 namespace loader {
 
-std::pair<std::vector<vertex>, std::vector<unsigned int>> load_asset(const char* path) {
+static constexpr uint32_t import_flags =
+	aiProcess_MakeLeftHanded |
+	aiProcess_FlipWindingOrder |
+	aiProcess_FlipUVs |
+	aiProcess_PreTransformVertices |
+	aiProcess_CalcTangentSpace |
+	aiProcess_GenSmoothNormals |
+	aiProcess_Triangulate |
+	aiProcess_FixInfacingNormals |
+	aiProcess_FindInvalidData |
+	aiProcess_ValidateDataStructure;
+
+
+mesh_bounds compute_bounds(const vertex *vertices, size_t vertex_count) {
+	if (!vertex_count)
+		return mesh_bounds{ glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, 0.0f };
+
+	glm::vec3 lo = vertices[0].position;
+	glm::vec3 hi = vertices[0].position;
+	for (size_t i = 1; i < vertex_count; ++i) {
+		lo = glm::min(lo, vertices[i].position);
+		hi = glm::max(hi, vertices[i].position);
+	}
+
+	glm::vec3 center = (lo + hi) * 0.5f;
+
+	float radius_squared = 0.0f;
+	for (size_t i = 0; i < vertex_count; ++i) {
+		glm::vec3 d = vertices[i].position - center;
+		radius_squared = std::max(radius_squared, glm::dot(d, d));
+	}
+
+	return mesh_bounds{ lo, hi, center, std::sqrt(radius_squared) };
+}
+
+
+mesh_data::mesh_data(std::vector<vertex> vertices, std::vector<unsigned int> indices, std::vector<mesh_lod> lods)
+	: vertices_(std::move(vertices)), indices_(std::move(indices)),
+	vertex_data_(vertices_.data()), vertex_count_(vertices_.size()),
+	index_data_(indices_.data()), index_count_(indices_.size()),
+	bounds_(compute_bounds(vertex_data_, vertex_count_)), lods_(std::move(lods)) {
+	if (lods_.empty())
+		lods_.push_back(mesh_lod{ 0, (uint32_t)index_count_, 0.0f });
+
+	positions_.reserve(vertices_.size());
+	for (const vertex &v : vertices_)
+		positions_.push_back(v.position);
+
+	position_data_ = positions_.data();
+}
+
+
+mesh_data::mesh_data(mapped_file file, const vertex *vertices, const glm::vec3 *positions, size_t vertex_count,
+	const unsigned int *indices, size_t index_count, const mesh_bounds &bounds, std::vector<mesh_lod> lods)
+	: file_(std::move(file)), vertex_data_(vertices), position_data_(positions), vertex_count_(vertex_count),
+	index_data_(indices), index_count_(index_count), bounds_(bounds), lods_(std::move(lods)) {}
+
+
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_assimp(const char* path) {
 	std::vector<unsigned int> indices;
 	std::vector<vertex> vertices;
 
 	Assimp::Importer importer;
 
-	const aiScene* scene = importer.ReadFile(path,
-		aiProcess_MakeLeftHanded |
-		aiProcess_FlipWindingOrder |
-		aiProcess_FlipUVs |
-		aiProcess_PreTransformVertices |
-		aiProcess_CalcTangentSpace |
-		aiProcess_GenSmoothNormals |
-		aiProcess_Triangulate |
-		aiProcess_FixInfacingNormals |
-		aiProcess_FindInvalidData |
-		aiProcess_ValidateDataStructure);
+	const aiScene* scene = importer.ReadFile(path, import_flags);
 	if (!scene) {
 		throw asset_error(path);
 	}
 
-	const aiMesh* mesh = scene->mMeshes[0];
-	if (!mesh->mNumUVComponents[0]) {
-		throw std::exception("Mesh does not contain uv coordinates");
+	if (!scene->mNumMeshes) {
+		throw asset_error(path);
 	}
 
 	if (scene->HasMaterials()) {
@@ -50,28 +110,104 @@ std::pair<std::vector<vertex>, std::vector<unsigned int>> load_asset(const char*
 		}
 	}
 
-	vertices.reserve(mesh->mNumVertices);
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		aiVector3D pos = mesh->mVertices[i];
-		aiVector3D norm = mesh->mNormals[i];
-		aiVector3D uv = mesh->mTextureCoords[0][i];
-
-		vertices.push_back({
-			glm::vec3{pos.x, pos.y, pos.z},
-			glm::vec3{norm.x, norm.y, norm.z},
-			glm::vec2{uv.x, uv.y}
-		});
-	}
+	/* aiProcess_PreTransformVertices has baked the node transforms, so the meshes only
+	 * need appending. Each one's indices move past the vertices before it. */
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+		const aiMesh* mesh = scene->mMeshes[m];
+		const unsigned int first = (unsigned int)vertices.size();
 
-	indices.reserve(3 * mesh->mNumFaces);
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		// AssumewW the model has only triangles.
-		indices.push_back(mesh->mFaces[i].mIndices[0]);
-		indices.push_back(mesh->mFaces[i].mIndices[1]);
-		indices.push_back(mesh->mFaces[i].mIndices[2]);
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+			aiVector3D pos = mesh->mVertices[i];
+			aiVector3D norm = mesh->mNormals ? mesh->mNormals[i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+			aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+
+			vertices.push_back({
+				glm::vec3{pos.x, pos.y, pos.z},
+				glm::vec3{norm.x, norm.y, norm.z},
+				glm::vec2{uv.x, uv.y}
+			});
+		}
+
+		/* Triangulation leaves points and lines as they are, they aren't drawn */
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+			const aiFace &face = mesh->mFaces[i];
+			if (face.mNumIndices != 3)
+				continue;
+
+			indices.push_back(first + face.mIndices[0]);
+			indices.push_back(first + face.mIndices[1]);
+			indices.push_back(first + face.mIndices[2]);
+		}
 	}
 
 	return std::make_pair(std::move(vertices), std::move(indices));
 }
 
-}
\ No newline at end of file
+
+static std::string extension_of(const char* path) {
+	std::string extension = std::filesystem::path{ path }.extension().string();
+	for (char &c : extension)
+		c = (char)std::tolower((unsigned char)c);
+
+	return extension;
+}
+
+
+mesh_data load_asset(const char* path, const weld_options &weld) {
+	using clock = std::chrono::high_resolution_clock;
+
+	auto start = clock::now();
+
+	const std::string extension = extension_of(path);
+	const bool obj = extension == ".obj";
+	const bool glb = extension == ".glb";
+
+	uint64_t key;
+	try {
+		key = cache_key(mapped_file{ path }, import_flags);
+		key = hash_bytes(&weld, sizeof(weld), key);
+		if (obj)
+			key = hash_bytes(&obj_parser_version, sizeof(obj_parser_version), key);
+		if (glb)
+			key = hash_bytes(&gltf_loader_version, sizeof(gltf_loader_version), key);
+	} catch (const mapping_error &) {
+		throw asset_error(path);
+	}
+
+	auto cached_path = cache_path(path, key);
+
+	if (auto cached = read_cache(cached_path, key)) {
+		std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+		spdlog::info("Loaded {} from {} in {:.2f} ms (warm)", path, cached_path.string(), elapsed.count());
+
+		return std::move(*cached);
+	}
+
+	auto [vertices, indices] = obj ? import_obj(path) : glb ? import_glb(path) : flatten_scene(load_scene(path, weld));
+
+	weld_stats welded = weld_vertices(vertices, indices, weld);
+	spdlog::info("Welded {}: {} -> {} vertices, {:.1f} KiB saved", path,
+		welded.vertices_before, welded.vertices_after, welded.bytes_saved() / 1024.0);
+
+	mesh_metrics before = analyze_mesh(vertices, indices);
+	optimize_mesh(vertices, indices);
+	mesh_metrics after = analyze_mesh(vertices, indices);
+
+	spdlog::info("Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, overdraw {:.3f} -> {:.3f}", path,
+		before.acmr, after.acmr, before.atvr, after.atvr, before.overdraw, after.overdraw);
+
+	auto lods = build_lods(vertices, indices);
+	for (size_t i = 1; i < lods.size(); ++i)
+		spdlog::info("LOD {} of {}: {} triangles, error {:.4f}", i, path, lods[i].index_count / 3, lods[i].error);
+
+	mesh_data mesh{ std::move(vertices), std::move(indices), std::move(lods) };
+
+	write_cache(cached_path, key, mesh);
+
+	std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+	spdlog::info("Imported {} in {:.2f} ms (cold), {} vertices, {} indices", path, elapsed.count(), mesh.vertex_count(), mesh.index_count());
+
+	return mesh;
+}
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "mapped_file.h"
 #include <vector>
+#include <optional>
+#include <utility>
 #include <glm/glm.hpp>
 #include <stdexcept>
 
@@ -24,6 +27,103 @@ struct vertex {
     glm::vec2 uvs;
 };
 
-std::pair<std::vector<vertex>, std::vector<unsigned int>> load_asset(const char* path);
+/* Model space bounds of a mesh. The sphere is centered on the box and just
+ * reaches the farthest vertex, which is tighter than half the box diagonal. */
+struct mesh_bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+};
+
+mesh_bounds compute_bounds(const vertex *vertices, size_t vertex_count);
+
+/* Level of detail 0 is the full mesh, see build_lods */
+constexpr size_t max_lods = 4;
+
+/* Range of the shared index array holding one level of detail */
+struct mesh_lod {
+    uint32_t index_offset;
+    uint32_t index_count;
+    /* Largest distance of the simplified surface from the full one, in model units */
+    float error;
+};
+
+/* Range of a scene's shared vertex and index arrays holding one of its meshes.
+ * Indices start from 0 in every submesh, base_vertex is added to them at draw time. */
+struct submesh {
+    uint32_t base_vertex;
+    uint32_t vertex_count;
+    uint32_t first_index;
+    uint32_t index_count;
+    /* Into scene_data::materials */
+    uint32_t material;
+    /* In model space, node transforms included */
+    mesh_bounds bounds;
+};
+
+/* Vertex and index arrays of a loaded asset. They are either owned or point straight
+ * into a mapped cache file, so a warm load can go to glBufferData without a copy.
+ * The positions are repeated in a tightly packed stream of their own for depth only
+ * passes, which then don't fetch normals and uvs. */
+class mesh_data {
+public:
+    /* Without lods the whole index array is the only level */
+    mesh_data(std::vector<vertex> vertices, std::vector<unsigned int> indices, std::vector<mesh_lod> lods = {});
+    mesh_data(mapped_file file, const vertex *vertices, const glm::vec3 *positions, size_t vertex_count,
+        const unsigned int *indices, size_t index_count, const mesh_bounds &bounds, std::vector<mesh_lod> lods);
+
+    mesh_data(const mesh_data &other) = delete;
+    mesh_data &operator=(const mesh_data &other) = delete;
+
+    mesh_data(mesh_data &&other) noexcept = default;
+    mesh_data &operator=(mesh_data &&other) noexcept = default;
+
+    const vertex *vertex_data() const { return vertex_data_; }
+    const glm::vec3 *position_data() const { return position_data_; }
+    size_t vertex_count() const { return vertex_count_; }
+
+    const unsigned int *index_data() const { return index_data_; }
+    size_t index_count() const { return index_count_; }
+
+    const mesh_bounds &bounds() const { return bounds_; }
+
+    /* Levels of detail, all of them ranges of index_data() */
+    const std::vector<mesh_lod> &lods() const { return lods_; }
+
+private:
+    std::vector<vertex> vertices_;
+    std::vector<glm::vec3> positions_;
+    std::vector<unsigned int> indices_;
+    std::optional<mapped_file> file_;
+
+    const vertex *vertex_data_;
+    const glm::vec3 *position_data_;
+    size_t vertex_count_;
+    const unsigned int *index_data_;
+    size_t index_count_;
+
+    mesh_bounds bounds_;
+    std::vector<mesh_lod> lods_;
+};
+
+/* With an epsilon of 0 only bitwise identical attributes are merged. Otherwise each
+ * attribute is snapped to a grid of that spacing and vertices landing in the same
+ * cell are merged into the first of them. */
+struct weld_options {
+    float position_epsilon = 0.0f;
+    float normal_epsilon = 0.0f;
+    float uv_epsilon = 0.0f;
+};
+
+/* Vertices and indices as Assimp imports the file, before welding and optimization.
+ * Every mesh of the file is appended, with the node transforms baked in. */
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_assimp(const char* path);
+
+/* Imports the asset, or maps it from the mesh cache when an entry for the same
+ * file contents and import settings exists. .obj files skip Assimp for import_obj,
+ * .glb files for import_glb, which merges all their primitives. Other formats go
+ * through load_scene, its submeshes merged into one mesh with flatten_scene. */
+mesh_data load_asset(const char* path, const weld_options &weld = {});
 
 }
\ No newline at end of file
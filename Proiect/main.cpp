@@ -1,7 +1,27 @@
 #include "shader.h"
 #include "loader.h"
+#include "scene_import.h"
 #include "cube.h"
+#include "light.h"
+#include "cluster.h"
+#include "light_buffer.h"
+#include "mesh.h"
+#include "instancing.h"
 #include "euler_angle.h"
+#include "asset_pool.h"
+#include "texture_streamer.h"
+#include "frame_uniforms.h"
+#include "program_variants.h"
+#include "render_queue.h"
+#include "frustum_cull.h"
+#include "transform.h"
+#include "transform_batch.h"
+#include "benchmarks.h"
+#include "deferred.h"
+#include "frame_benchmark.h"
+#include "scene_generator.h"
+#include "profiler.h"
+#include "gpu_timer.h"
 
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,9 +30,7 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
+#include <algorithm>
 #include <cstdio>
 #include <string>
 #include <memory>
@@ -23,15 +41,9 @@
 
 /* Codul asta nu e cel mai bun pe care l-am scris ... dar nici nu-i cel mai rau */
 
-const size_t n_vertices = sizeof(vertices) / (6 * sizeof(float));
-
-
 struct user_input_data {
     std::unordered_map<int, bool> keys;
 
-    int view_location;
-    int viewpos_location;
-
     glm::vec3 &viewpos;
     glm::vec3 &forward;
 
@@ -45,82 +57,10 @@ struct user_input_data {
 };
 
 
-static inline int get_location(uint32_t program, const char *uniform_name) {
-    int location = glGetUniformLocation(program, uniform_name);
-    if (location == -1)
-        spdlog::warn("Uniform {} was not found in the program", uniform_name);
-
-    return location;
-}
-
-
-class light {
-public:
-    light (uint32_t program, std::string name, glm::vec3 position = glm::vec3(0.0f), glm::vec3 color = glm::vec3(1.0f))
-        : program(program), name(name), position(position), ambient(0.3f), color(color), constant(2.0f), linear(0.2f), quadratic(0.01f) {
-        position_loc = get_location(program, (name + ".position").c_str());
-
-        ambient_loc = get_location(program, (name + ".ambient").c_str());
-
-        constant_loc = get_location(program, (name + ".constant").c_str());
-        linear_loc = get_location(program, (name + ".linear").c_str());
-        quadratic_loc = get_location(program, (name + ".quadratic").c_str());
-
-        color_loc = get_location(program, (name + ".color").c_str());
-
-        light_color_location = get_location(program, "u_light_color");
-    }
-
-    void update() {
-        glUseProgram(program);
-
-        glUniform3fv(position_loc, 1, glm::value_ptr(position));
-
-        glUniform3fv(ambient_loc, 1, glm::value_ptr(ambient));
-
-        glUniform3fv(color_loc, 1, glm::value_ptr(color));
-
-        glUniform1f(constant_loc, constant);
-        glUniform1f(linear_loc, linear);
-        glUniform1f(quadratic_loc, quadratic);
-    }
-
-    void draw(int model_location) {
-        glUseProgram(program);
-
-        glUniform3fv(light_color_location, 1, glm::value_ptr(color));
-
-        auto model = glm::translate(position) * glm::scale(glm::vec3{ 0.2f });
-
-        glUniformMatrix4fv(model_location, 1, GL_FALSE, glm::value_ptr(model));
-
-        glDrawArrays(GL_TRIANGLES, 0, n_vertices);
-    }
-
-    const uint32_t program;
-    const std::string name;
-
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 color;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-private:
-    int position_loc;
-    int ambient_loc;
-    int constant_loc;
-    int linear_loc;
-    int quadratic_loc;
-    int color_loc;
-    int light_color_location;
-};
-
-
-void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint32_t vao,
-                   uint32_t ibo, std::vector<unsigned int> &indices, uint32_t tree_vao, uint32_t tree_ibo, std::vector<unsigned int> &tree_ind);
+void run_main_loop(GLFWwindow* window, const gpu_mesh &cube_mesh, const gpu_mesh &gizmo_mesh,
+                   const gpu_mesh &ferrari_mesh, const gpu_mesh &tree_mesh,
+                   asset_pool &assets, texture_streamer &textures, size_t ferrari_tex, size_t tree_tex,
+                   const stress_scene *scene, frame_benchmark *benchmark);
 
 
 #ifdef _DEBUG
@@ -230,41 +170,92 @@ static void process_mouse_movement(GLFWwindow *window, user_input_data &key_data
 }
 
 
-texture_t load_texture(const std::string &path, unsigned int slot, bool invert) {
-    GLuint texture;
+/* Command line of a windowed or benchmark run:
+ *   --headless [report.json] [--warmup N] [--frames N] [--size WxH] [--egl | --osmesa]
+ *   --objects N[,N...] --lights N[,N...] [--layout grid|ring|clusters] [--seed N]
+ *   --scene path
+ * The second line swaps the default scene for generated ones. A windowed run takes the
+ * first counts, a benchmark runs every object count with every light count. The third
+ * imports a file with loader::load_scene and draws it in the tree's place, one draw per
+ * submesh. Its materials aren't bound, so it is drawn untextured. */
+struct launch_options {
+    bool headless = false;
+    frame_benchmark_options benchmark;
+
+    bool generated = false;
+    std::vector<uint32_t> object_counts{ 1000 };
+    std::vector<uint32_t> light_counts{ 64 };
+    scene_layout layout = scene_layout::grid;
+    uint32_t seed = 1;
+
+    std::string scene_path;
+};
 
-    glGenTextures(1, &texture);
 
-    glActiveTexture(slot);
-    glBindTexture(GL_TEXTURE_2D, texture);
+static std::vector<uint32_t> parse_counts(const std::string &list) {
+    std::vector<uint32_t> counts;
 
-    if (invert) {
-        stbi_set_flip_vertically_on_load(1);
-    }
-    else {
-        stbi_set_flip_vertically_on_load(0);
+    for (size_t begin = 0; begin < list.size(); ) {
+        size_t end = std::min(list.find(',', begin), list.size());
+        counts.push_back((uint32_t)std::stoul(list.substr(begin, end - begin)));
+        begin = end + 1;
     }
 
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-            GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        throw std::exception("Failed to load texture");
+    return counts;
+}
+
+
+static launch_options parse_launch_options(int argc, char **argv) {
+    launch_options launch;
+    frame_benchmark_options &options = launch.benchmark;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg{ argv[i] };
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--headless")
+            launch.headless = true;
+        else if (arg == "--warmup" && has_value)
+            options.warmup_frames = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--frames" && has_value)
+            options.measured_frames = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--size" && has_value && std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) == 2)
+            continue;
+        else if (arg == "--egl" || arg == "--osmesa")
+            options.context = arg == "--egl" ? context_api::egl : context_api::osmesa;
+        else if ((arg == "--objects" || arg == "--lights") && has_value) {
+            (arg == "--objects" ? launch.object_counts : launch.light_counts) = parse_counts(argv[++i]);
+            launch.generated = true;
+        } else if (arg == "--layout" && has_value) {
+            std::string name{ argv[++i] };
+            std::optional<scene_layout> layout = parse_layout(name);
+            if (!layout)
+                throw std::invalid_argument("--layout takes grid, ring or clusters, not " + name);
+
+            launch.layout = *layout;
+        } else if (arg == "--seed" && has_value)
+            launch.seed = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--scene" && has_value)
+            launch.scene_path = argv[++i];
+        else if (launch.headless && arg.rfind("--", 0) != 0)
+            options.report_path = arg;
+        else
+            spdlog::warn("Ignoring argument {}", arg);
     }
-    stbi_image_free(data);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIPMAP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIPMAP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (launch.object_counts.empty() || launch.light_counts.empty())
+        throw std::invalid_argument("--objects and --lights need at least one count");
+
+#ifndef GLEW_EGL
+    if (options.context == context_api::egl)
+        throw std::invalid_argument("--egl needs GLEW built with GLEW_EGL");
+#endif
+#ifndef GLEW_OSMESA
+    if (options.context == context_api::osmesa)
+        throw std::invalid_argument("--osmesa needs GLEW built with GLEW_OSMESA");
+#endif
 
-    return texture_t{ texture };
+    return launch;
 }
 
 
@@ -283,46 +274,43 @@ struct imgui_context_t {
 };
 
 
-struct transform {
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
-
-    transform(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) :
-        position(position), rotation(rotation), scale(scale) {}
-
-    glm::mat4 to_model() const {
-        return glm::translate(position)
-            * glm::rotate(glm::radians(rotation.x), glm::vec3{ 1.0f, 0.0f, 0.0f })
-            * glm::rotate(glm::radians(rotation.y), glm::vec3{ 0.0f, 1.0f, 0.0f })
-            * glm::rotate(glm::radians(rotation.z), glm::vec3{ 0.0f, 1.0f, 1.0f })
-            * glm::scale(scale);
-    }
-};
-
-
-void render_transform(const transform& transform, int model_location, int normal_location) {
-    auto model = transform.to_model();
-
-    glUniformMatrix4fv(model_location, 1, GL_FALSE, glm::value_ptr(model));
-
-    auto normal_matrix = glm::transpose(glm::inverse(model));
-
-    glUniformMatrix4fv(normal_location, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-}
-
-
-int main() {
+int main(int argc, char **argv) {
     try {
 #ifdef _DEBUG
         spdlog::set_level(spdlog::level::debug);
 #endif
-        srand(time(NULL));
+        if (argc > 1 && std::string{ argv[1] } == "--bench") {
+            run_benchmarks(argc, argv);
+
+            return 0;
+        }
+
+        /* A headless run follows a fixed camera path in a hidden window and writes a frame time report */
+        launch_options launch = parse_launch_options(argc, argv);
+
+        /* The benchmark places the tree's lights the same way every run */
+        srand(launch.headless ? 0 : time(NULL));
 
         glfw_t glfw;
         spdlog::info("Initialized GLFW");
 
-        window_t window{ glfwCreateWindow(1080, 720, "Proiect SPG", NULL, NULL), glfwDestroyWindow };
+        int window_width = 1080;
+        int window_height = 720;
+
+        /* The hidden window keeps the native context, so the WGL build of GLEW finds its
+         * entry points. Without a GPU, Mesa's llvmpipe opengl32.dll dropped next to the exe
+         * serves it. EGL and OSMesa are opt-in, for builds whose GLEW targets them. */
+        if (launch.headless) {
+            window_width = launch.benchmark.width;
+            window_height = launch.benchmark.height;
+
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            if (launch.benchmark.context != context_api::native)
+                glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+                               launch.benchmark.context == context_api::egl ? GLFW_EGL_CONTEXT_API : GLFW_OSMESA_CONTEXT_API);
+        }
+
+        window_t window{ glfwCreateWindow(window_width, window_height, "Proiect SPG", NULL, NULL), glfwDestroyWindow };
         if (!window) {
             spdlog::error("Failed to create glfw window.");
 
@@ -342,6 +330,10 @@ int main() {
         glfwMakeContextCurrent(window.get());
         spdlog::info("Initialized OpenGL context");
 
+        /* Frame times are the point of the benchmark, vsync would hide them */
+        if (launch.headless)
+            glfwSwapInterval(0);
+
         imgui_context_t imgui{window.get(), "#version 330"};
 
         ImGui::StyleColorsDark();
@@ -363,97 +355,100 @@ int main() {
 #endif
         glEnable(GL_DEPTH_TEST);
 
-        uint32_t handle;
-        glGenVertexArrays(1, &handle);
-        vertex_array_t cube_vao{ handle };
-
-        glBindVertexArray(cube_vao.get());
-
-        glGenBuffers(1, &handle);
-        buffer_t cube_vbo{ handle };
-
-        glBindBuffer(GL_ARRAY_BUFFER, cube_vbo.get());
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
-
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, 0, sizeof(vertex), NULL);
-
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, 0, sizeof(vertex), (const void *)(sizeof(glm::vec3)));
-
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, 0, sizeof(vertex), (const void *)sizeof(glm::vec3));
+        auto load_start = std::chrono::high_resolution_clock::now();
 
-        /* Loading and creating ferrari model */
-        auto [vertices, indices] = loader::load_asset("ferrari.obj");
-        
-        glGenVertexArrays(1, &handle);
-        vertex_array_t vao{ handle };
-
-        glBindVertexArray(vao.get());
-
-        glGenBuffers(1, &handle);
-        buffer_t vbo{ handle };
+        /* Imports and decodes run on the pool, the uploads happen here as they finish */
+        asset_pool assets;
 
-        glGenBuffers(1, &handle);
-        buffer_t ibo{ handle };
+        /* Textures keep streaming in during the first frames, showing a placeholder until then */
+        texture_streamer textures{ assets };
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+        std::optional<gpu_mesh> ferrari_mesh;
+        std::optional<gpu_mesh> tree_mesh;
 
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), vertices.data(), GL_STATIC_DRAW);
+        auto submit_mesh = [&assets](const char *path, std::optional<gpu_mesh> &out) {
+            assets.submit([path, &out]() -> asset_pool::continuation {
+                auto data = std::make_shared<loader::mesh_data>(loader::load_asset(path));
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, 0, sizeof(loader::vertex), NULL);
+                return [data, &out]() { out.emplace(upload_mesh(*data, vertex_format::packed)); };
+            });
+        };
 
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, 0, sizeof(loader::vertex), (const void *)(sizeof(glm::vec3)));
+        /* Scenes keep their meshes apart as submeshes of the one upload */
+        auto submit_scene = [&assets](const char *path, std::optional<gpu_mesh> &out) {
+            assets.submit([path, &out]() -> asset_pool::continuation {
+                auto data = std::make_shared<loader::scene_data>(loader::load_scene(path));
 
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, 0, sizeof(loader::vertex), (const void *)(2 * sizeof(glm::vec3)));
+                return [data, &out]() { out.emplace(upload_mesh(*data, vertex_format::packed)); };
+            });
+        };
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo.get());
-        
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(indices[0]), indices.data(), GL_STATIC_DRAW);
-
-        program_t program = load_program("vertex.glsl", "fragment.glsl");
+        submit_mesh("ferrari.obj", ferrari_mesh);
+        if (launch.scene_path.empty())
+            submit_mesh("new_tree2.obj", tree_mesh);
+        else
+            submit_scene(launch.scene_path.c_str(), tree_mesh);
+        size_t ferrari_tex = textures.request("ferrari.png", false);
+        size_t tree_tex = textures.request("tree.jpg", false);
 
-        texture_t texture = load_texture("ferrari.png", GL_TEXTURE0, false);
+        const loader::mesh_bounds cube_bounds = loader::compute_bounds(vertices, n_vertices);
 
-        auto [tree_vert, tree_ind] = loader::load_asset("new_tree2.obj");
+        gpu_mesh cube_mesh = upload_mesh(vertices, n_vertices, NULL, 0, cube_bounds, vertex_format::packed);
 
-        glGenVertexArrays(1, &handle);
-        vertex_array_t tree_vao{ handle };
+        /* The light gizmos are cubes too, but get their own mesh to hold their instance attributes */
+        gpu_mesh gizmo_mesh = upload_mesh(vertices, n_vertices, NULL, 0, cube_bounds, vertex_format::packed);
 
-        glBindVertexArray(tree_vao.get());
+        /* Only the meshes are waited for. The texture decodes keep running and are picked up
+         * by the per frame poll, drawing the placeholder until then. */
+        while (!ferrari_mesh || !tree_mesh) {
+            if (!assets.wait_one())
+                throw std::runtime_error("Mesh jobs finished without producing their meshes");
+        }
 
-        glGenBuffers(1, &handle);
-        buffer_t tree_vbo{ handle };
+        auto load_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - load_start);
+        spdlog::info("Loaded meshes in {} ms, textures still streaming", load_time.count());
 
-        glGenBuffers(1, &handle);
-        buffer_t tree_ibo{ handle };
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        const char *version = (const char *)glGetString(GL_VERSION);
 
-        glBindBuffer(GL_ARRAY_BUFFER, tree_vbo.get());
+        if (!launch.headless) {
+            std::optional<stress_scene> scene;
+            if (launch.generated)
+                scene = generate_scene({ launch.object_counts[0], launch.light_counts[0], launch.layout, launch.seed });
 
-        glBufferData(GL_ARRAY_BUFFER, tree_vert.size() * sizeof(tree_vert[0]), tree_vert.data(), GL_STATIC_DRAW);
+            run_main_loop(window.get(), cube_mesh, gizmo_mesh, *ferrari_mesh, *tree_mesh,
+                          assets, textures, ferrari_tex, tree_tex, scene ? &*scene : nullptr, nullptr);
+        } else if (!launch.generated) {
+            frame_benchmark benchmark{ launch.benchmark };
+            run_main_loop(window.get(), cube_mesh, gizmo_mesh, *ferrari_mesh, *tree_mesh,
+                          assets, textures, ferrari_tex, tree_tex, nullptr, &benchmark);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, 0, sizeof(loader::vertex), NULL);
+            benchmark.write_report(renderer, version);
+        } else {
+            /* Every scene gets a fresh main loop, so no state carries over from the previous one */
+            std::vector<sweep_point> points;
 
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, 0, sizeof(loader::vertex), (const void *)(sizeof(glm::vec3)));
+            for (uint32_t objects : launch.object_counts) {
+                for (uint32_t lights : launch.light_counts) {
+                    if (glfwWindowShouldClose(window.get()))
+                        break;
 
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, 0, sizeof(loader::vertex), (const void *)(2 * sizeof(glm::vec3)));
+                    stress_scene scene = generate_scene({ objects, lights, launch.layout, launch.seed });
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tree_ibo.get());
+                    frame_benchmark benchmark{ launch.benchmark };
+                    run_main_loop(window.get(), cube_mesh, gizmo_mesh, *ferrari_mesh, *tree_mesh,
+                                  assets, textures, ferrari_tex, tree_tex, &scene, &benchmark);
 
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, tree_ind.size() * sizeof(tree_ind[0]), tree_ind.data(), GL_STATIC_DRAW);
+                    points.push_back({ objects, lights, benchmark.summary() });
 
-        texture_t tree_tex = load_texture("tree.jpg", GL_TEXTURE1, false);
+                    const frame_benchmark_summary &s = points.back().summary;
+                    spdlog::info("{} objects, {} lights: p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms",
+                        objects, lights, s.p50_ms, s.p95_ms, s.p99_ms);
+                }
+            }
 
-        run_main_loop(window.get(), program.get(), cube_vao.get(),
-                      vao.get(), ibo.get(), indices, tree_vao.get(), tree_ibo.get(), tree_ind);
+            write_sweep_report(launch.benchmark, layout_name(launch.layout), launch.seed, points, renderer, version);
+        }
     } catch (const std::exception &ex) {
         spdlog::error("{}", ex.what());
 
@@ -466,21 +461,20 @@ int main() {
 }
 
 
-void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint32_t vao,
-    uint32_t ibo, std::vector<unsigned int> &indices, uint32_t tree_vao, uint32_t tree_ibo, std::vector<unsigned int> &tree_ind) {
+void run_main_loop(GLFWwindow* window, const gpu_mesh &cube_mesh, const gpu_mesh &gizmo_mesh,
+    const gpu_mesh &ferrari_mesh, const gpu_mesh &tree_mesh,
+    asset_pool &assets, texture_streamer &textures, size_t ferrari_tex, size_t tree_tex,
+    const stress_scene *scene, frame_benchmark *benchmark) {
     using namespace std::chrono_literals;
 
     int width, height;
     glfwGetWindowSize(window, &width, &height);
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+    const float fov = glm::radians(45.0f);
+    const float near_plane = 0.1f;
+    const float far_plane = 100.0f;
 
-    int model_location = get_location(program, "u_model");
-    int view_location = get_location(program, "u_view");
-    int viewpos_location = get_location(program, "u_viewpos");
-    int normal_location = get_location(program, "u_normal");
-    
-    int cubecolor_location = get_location(program, "u_color");
+    glm::mat4 projection = glm::perspective(fov, (float)width / height, near_plane, far_plane);
 
     transform tree{ glm::vec3{0.0f}, glm::vec3{0.0f}, glm::vec3{0.1f} };
     std::vector<float> langles;
@@ -503,12 +497,12 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
         fangles.push_back(degrees);
         langles.push_back(degrees);
 
-        lights.emplace_back(program, "u_light[" + std::to_string(i) + "]", glm::vec3{ dl * c, -3, dl * s }, glm::vec3{ (c + 1.5) / 2, (s + 1.5) / 2, 0.5f });
+        lights.emplace_back(glm::vec3{ dl * c, -3, dl * s }, glm::vec3{ (c + 1.5) / 2, (s + 1.5) / 2, 0.5f });
 
         ferraris.emplace_back(glm::vec3{df * c, -4.0f, df * s}, glm::vec3{0.0f, -degrees, 0.0f}, glm::vec3{0.015f});
     }
 
-    lights.emplace_back(program, "u_light[" + std::to_string(n_copies) + "]", glm::vec3{0.0f, center_light_pos_y, 0.0f});
+    lights.emplace_back(glm::vec3{0.0f, center_light_pos_y, 0.0f});
 
     float tree_bottom = -3;
     float tree_top = 10;
@@ -529,7 +523,7 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
             float c = cos(radians);
             float s = sin(radians);
 
-            light l{program, "u_light[" + std::to_string(lights.size()) + "]", glm::vec3{ radius * c, y, radius * s }, glm::vec3{ (c + 1.5) / 2, (s + 1.5) / 2, 0.5f }};
+            light l{glm::vec3{ radius * c, y, radius * s }, glm::vec3{ (c + 1.5) / 2, (s + 1.5) / 2, 0.5f }};
             l.constant = 0.0f;
             l.linear = 0.0f;
             l.quadratic = 5.0f;
@@ -538,32 +532,161 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
         }
     }
 
-    glUseProgram(program);
+    /* A generated scene replaces the ferraris and every light */
+    if (scene) {
+        ferraris = scene->objects;
+        lights = scene->lights;
+        fangles.assign(ferraris.size(), 0.0f);
+        langles.assign(ferraris.size(), 0.0f);
+    }
+
+    const uint32_t light_block_binding = 0;
+    const uint32_t frame_block_binding = 1;
+
+    light_buffer light_buf;
+    frame_uniforms frame_ubo;
 
-    /* Set up projection, it won't change for the rest of the program */
-    int proj_location = get_location(program, "u_proj");
-    glUniformMatrix4fv(proj_location, 1, GL_FALSE, glm::value_ptr(projection));
+    /* Texture unit 0 holds the texture of the mesh being drawn */
+    const int cluster_grid_unit = 2;
+    const int cluster_index_unit = 3;
+    /* And the three G-buffer textures from here on */
+    const int gbuffer_unit = 4;
 
-    int type_location = get_location(program, "u_type");
-    
-    int n_lights_location = get_location(program, "u_n_lights");
+    cluster_grid clusters{ fov, (float)width / height, near_plane, far_plane };
+
+    bool clustered = true;
+
+    program_variants programs{ "vertex.glsl", "fragment.glsl", [&](uint32_t program, const shader_variant &variant) {
+        frame_ubo.setup_program(program, frame_block_binding);
+
+        if (variant.textured)
+            glUniform1i(get_location(program, "u_tex"), 0);
+
+        if (variant.lit)
+            light_buf.setup_program(program, light_block_binding);
+
+        if (variant.clustered)
+            clusters.setup_program(program, cluster_grid_unit, cluster_index_unit);
+    } };
+
+    /* Deferred shading draws the scene into the G-buffer and lights it in one full screen pass */
+    deferred_pass deferred;
+    bool deferred_shading = false;
+
+    program_variants lighting_programs{ "fullscreen_vertex.glsl", "fragment.glsl", [&](uint32_t program, const shader_variant &variant) {
+        frame_ubo.setup_program(program, frame_block_binding);
+        light_buf.setup_program(program, light_block_binding);
+        deferred.setup_program(program, gbuffer_unit);
+
+        if (variant.clustered)
+            clusters.setup_program(program, cluster_grid_unit, cluster_index_unit);
+    } };
+
+    auto variant_for = [&](const gpu_mesh &mesh, bool lit, bool textured) {
+        shader_variant variant;
+        variant.lit = lit;
+        variant.textured = textured;
+        variant.packed_normals = mesh.format == vertex_format::packed;
+
+        if (deferred_shading) {
+            variant.gbuffer = true;
+        } else {
+            variant.clustered = lit && clustered;
+            variant.max_lights = lit && !clustered ? light_bucket(light_buf.size()) : 0;
+        }
+
+        return programs.get(variant);
+    };
+
+    auto lighting_variant = [&]() {
+        shader_variant variant;
+        variant.deferred = true;
+        variant.clustered = clustered;
+        variant.max_lights = clustered ? 0 : light_bucket(light_buf.size());
+
+        return lighting_programs.get(variant);
+    };
+
+    render_queue queue{ far_plane };
+
+    program_t depth_program = load_program("depth_vertex.glsl", "depth_fragment.glsl");
+    frame_ubo.setup_program(depth_program.get(), frame_block_binding);
+
+    bool prepass = true;
+
+    /* Shades a number of frames without the prepass and as many with it, then logs both.
+     * The first frames of each half are skipped while the queries catch up. */
+    const int compare_frames = 120;
+    const int compare_warmup = 8;
+    int compare_frame = -1;
+    bool compare_restore = prepass;
+    uint64_t compare_fragments[2] = {};
+    double compare_ms[2] = {};
+
+    instance_batch platform_batch;
+    instance_batch gizmo_batch;
+    instance_batch ferrari_batch;
+    instance_batch tree_batch;
+
+    platform_batch.attach(cube_mesh);
+    gizmo_batch.attach(gizmo_mesh);
+    ferrari_batch.attach(ferrari_mesh);
+    tree_batch.attach(tree_mesh);
+
+    transform platform{ {0.0f, -4.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {100.0f, 0.1f, 100.0f} };
+
+    /* The platform and the tree never move, so only the ferraris are recomputed each frame */
+    transform_batch transforms;
+    uint32_t platform_id = transforms.add(platform, true);
+    uint32_t tree_id = transforms.add(tree, true);
+    uint32_t first_ferrari = (uint32_t)transforms.size();
+    for (const auto &ferrari : ferraris)
+        transforms.add(ferrari);
+
+    /* Lights come and go from the UI, their gizmos are rebuilt every frame */
+    transform_batch gizmo_transforms;
+
+    /* Every drawable instance, refilled each frame and culled before it reaches a batch */
+    struct scene_object {
+        instance_batch *batch;
+        /* View depth of the batch's nearest visible instance */
+        float *nearest;
+        glm::mat4 model;
+        glm::mat3 normal;
+        glm::vec3 color;
+        /* View depth, the w of the clip space origin */
+        float depth;
+        uint32_t lod;
+        uint32_t triangles;
+    };
+
+    std::vector<scene_object> objects;
+    cull_set culling;
+    std::vector<uint32_t> visible;
+    bool cull = true;
+
+    /* Level of detail of every transform, kept between frames for the hysteresis */
+    std::vector<uint32_t> object_lods(transforms.size(), 0);
+    bool lod_enabled = true;
+    /* Largest screen space error a level may have, in pixels */
+    float lod_threshold = 1.0f;
+    size_t triangles_drawn = 0;
+    std::chrono::duration<double, std::micro> cull_time{ 0.0 };
 
     /* Initial viewer position */
     glm::vec3 viewpos{4.0f, 54.0f, -48.0f};
-    glUniform3fv(viewpos_location, 1, glm::value_ptr(viewpos));
 
     double last_xpos, last_ypos;
     glfwGetCursorPos(window, &last_xpos, &last_ypos);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmark)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     std::chrono::microseconds dt = 0us;
 
     glm::vec3 forward{ 0, 0, 1 };
     struct user_input_data key_data{
         {},
-        view_location,
-        viewpos_location,
         viewpos,
         forward,
         false,
@@ -582,25 +705,48 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
     last_xpos /= width;
     last_ypos /= height;
 
-    bool start = true;
+    /* Generated scenes stay where they were laid out */
+    bool start = !scene;
 
     float x = 0;
 
-    int texture_location = get_location(program, "u_tex");
+    /* Scoped markers around each part of the frame, shown as a flame graph */
+    profiler frame_profiler;
+    bool show_profiler = false;
+
+    profile_thread_name("main");
+
+    /* Timestamps around each pass and draw, read back a few frames later */
+    gpu_timer gpu_times;
 
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !(benchmark && benchmark->done())) {
         auto start_frame_ts = std::chrono::high_resolution_clock::now();
 
+        if (benchmark) {
+            benchmark->begin_frame();
+            benchmark->camera(viewpos, forward);
+        }
+
+        gpu_times.begin_frame();
+
         glm::mat4 view = glm::lookAt(viewpos, viewpos + forward, glm::vec3{ 0, 1, 0 });
 
+        profile_begin("input");
+
         glfwPollEvents();
 
-        process_keypresses(window, key_data);
-        process_mouse_movement(window, key_data);
+        if (!benchmark) {
+            process_keypresses(window, key_data);
+            process_mouse_movement(window, key_data);
+        }
+
+        profile_end();
 
         glClearColor(clear_color.r, clear_color.g, clear_color.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        profile_begin("ui");
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -615,93 +761,300 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
             start ^= 1;
         }
 
-        for (int i = 0; i < ferraris.size(); ++i) {
-            std::string label = std::string{ "ferrari " } +std::to_string(i);
-            ImGui::Text(label.c_str());
+        /* Generated scenes have far too many objects and lights for an editor each */
+        if (!scene) {
+            for (int i = 0; i < ferraris.size(); ++i) {
+                std::string label = std::string{ "ferrari " } +std::to_string(i);
+                ImGui::Text(label.c_str());
 
-            ImGui::DragFloat3(("f_position_" + std::to_string(i)).c_str(), (float*)&ferraris[i].position, 0.1f);
-            ImGui::DragFloat3(("f_scale_" + std::to_string(i)).c_str(), (float*)&ferraris[i].scale, 0.001f);
-            ImGui::DragFloat3(("f_rotation_" + std::to_string(i)).c_str(), (float*)&ferraris[i].rotation);
-        }
+                ImGui::DragFloat3(("f_position_" + std::to_string(i)).c_str(), (float*)&ferraris[i].position, 0.1f);
+                ImGui::DragFloat3(("f_scale_" + std::to_string(i)).c_str(), (float*)&ferraris[i].scale, 0.001f);
+                ImGui::DragFloat3(("f_rotation_" + std::to_string(i)).c_str(), (float*)&ferraris[i].rotation);
+            }
 
-        for (int i = 0; i < lights.size(); ++i) {
-            std::string label = std::string{ "light " } +std::to_string(i);
-            ImGui::Text(label.c_str());
+            for (int i = 0; i < lights.size(); ++i) {
+                std::string label = std::string{ "light " } +std::to_string(i);
+                ImGui::Text(label.c_str());
 
-            ImGui::ColorEdit3(("l_color_" + std::to_string(i)).c_str(), (float*)&lights[i].color, 0.1f);
-            ImGui::DragFloat3(("l_position_" + std::to_string(i)).c_str(), (float*)&lights[i].position, 0.1f);
-            ImGui::DragFloat(("l_constant_" + std::to_string(i)).c_str(), &lights[i].constant, 0.01f);
-            ImGui::DragFloat(("l_linear_" + std::to_string(i)).c_str(), &lights[i].linear, 0.001f);
-            ImGui::DragFloat(("l_quadratic_" + std::to_string(i)).c_str(), &lights[i].quadratic, 0.0001f);
+                ImGui::ColorEdit3(("l_color_" + std::to_string(i)).c_str(), (float*)&lights[i].color, 0.1f);
+                ImGui::DragFloat3(("l_position_" + std::to_string(i)).c_str(), (float*)&lights[i].position, 0.1f);
+                ImGui::DragFloat(("l_constant_" + std::to_string(i)).c_str(), &lights[i].constant, 0.01f);
+                ImGui::DragFloat(("l_linear_" + std::to_string(i)).c_str(), &lights[i].linear, 0.001f);
+                ImGui::DragFloat(("l_quadratic_" + std::to_string(i)).c_str(), &lights[i].quadratic, 0.0001f);
+            }
         }
 
-        if (ImGui::Button("+ light")) {
-            lights.push_back({
-                program,
-                std::string{"u_light[" + std::to_string(lights.size()) + "]"}
-             });
+        if (ImGui::Button("+ light") && (light_buf.storage() || lights.size() < light_buffer::max_uniform_lights)) {
+            lights.emplace_back();
         }
 
         if (ImGui::Button("- light")) {
             lights.pop_back();
         }
 
+        ImGui::Checkbox("clustered lighting", &clustered);
+        if (clustered) {
+            const cluster_stats &cs = clusters.stats();
+            ImGui::Text("Lights culled %zu / %zu", cs.lights_culled, cs.lights_total);
+            ImGui::Text("Clusters occupied %zu / %d, max %zu lights, %zu references",
+                cs.occupied_clusters, cluster_grid::n_clusters, cs.max_lights_per_cluster, cs.light_references);
+        }
+
+        const light_buffer_stats &ls = light_buf.stats();
+        ImGui::Text("Light buffer: %zu dirty, %zu bytes in %zu GL calls", ls.dirty_lights, ls.bytes_uploaded, ls.gl_calls);
+
+        const texture_streamer_stats &ts = textures.stats();
+        ImGui::Text("Textures: %zu decoding, %zu queued, %zu uploading, %zu bytes streamed",
+            ts.decoding, ts.queued, ts.in_flight, ts.bytes_uploaded);
+
+        ImGui::Checkbox("deferred shading", &deferred_shading);
+
+        ImGui::Text("Shader variants compiled: %zu", programs.size() + lighting_programs.size());
+
+        ImGui::Checkbox("frustum culling", &cull);
+        ImGui::Text("Objects visible %zu / %zu, culled in %.1f us", visible.size(), objects.size(), cull_time.count());
+
+        ImGui::Checkbox("levels of detail", &lod_enabled);
+        ImGui::DragFloat("LOD error (px)", &lod_threshold, 0.05f, 0.25f, 16.0f);
+        ImGui::Text("Triangles drawn %zu", triangles_drawn);
+
+        const render_queue_stats &qs = queue.stats();
+        ImGui::Text("Render queue: %zu draws, %zu binds issued, %zu elided", qs.draws_submitted, qs.binds_issued, qs.binds_elided);
+
+        ImGui::Checkbox("depth prepass", &prepass);
+        ImGui::Text("Fragments shaded %llu (%.2f per pixel)", (unsigned long long)qs.fragments_shaded,
+            (double)qs.fragments_shaded / ((double)width * height));
+
+        if (compare_frame < 0 && ImGui::Button("compare prepass")) {
+            compare_frame = 0;
+            compare_restore = prepass;
+            compare_fragments[0] = compare_fragments[1] = 0;
+            compare_ms[0] = compare_ms[1] = 0.0;
+        }
+
+        if (compare_frame >= 0) {
+            int half = compare_frame / compare_frames;
+
+            if (compare_frame % compare_frames >= compare_warmup) {
+                compare_fragments[half] += qs.fragments_shaded;
+                compare_ms[half] += dt.count() / 1000.0;
+            }
+
+            if (++compare_frame == 2 * compare_frames) {
+                const int measured = compare_frames - compare_warmup;
+
+                spdlog::info("Without prepass: {} fragments shaded, {:.3f} ms a frame",
+                    compare_fragments[0] / measured, compare_ms[0] / measured);
+                spdlog::info("With prepass: {} fragments shaded, {:.3f} ms a frame",
+                    compare_fragments[1] / measured, compare_ms[1] / measured);
+
+                compare_frame = -1;
+                prepass = compare_restore;
+            } else {
+                prepass = compare_frame >= compare_frames;
+            }
+        }
+
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::Checkbox("profiler", &show_profiler);
+
+        if (ImGui::CollapsingHeader("GPU passes"))
+            gpu_times.draw_table();
+
         ImGui::End();
 
-        glBindVertexArray(cube_vao);
+        if (show_profiler)
+            frame_profiler.draw_window(&show_profiler);
 
-        glUseProgram(program);
-        
-        glUniform1i(n_lights_location, lights.size());
+        profile_end();
+
+        if (benchmark)
+            benchmark->end_phase(frame_phase::ui);
+
+        profile_begin("assets");
+        assets.poll();
+        textures.update();
+        profile_end();
+
+        int fb_width, fb_height;
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+
+        profile_begin("light upload");
+
+        light_buf.update(lights);
+        light_buf.bind();
+
+        packed_frame_uniforms frame{};
+        frame.view = view;
+        frame.proj = projection;
+        frame.viewpos = viewpos;
+        frame.n_lights = (int)light_buf.size();
+        frame.viewport_size = glm::vec2{ fb_width, fb_height };
+
+        frame_ubo.update(frame);
+        frame_ubo.bind();
+
+        if (clustered) {
+            clusters.build(view, lights, light_buf.size());
+            clusters.bind(cluster_grid_unit, cluster_index_unit);
+        }
+
+        profile_end();
 
-        glUniform3fv(viewpos_location, 1, glm::value_ptr(viewpos));
+        if (benchmark)
+            benchmark->end_phase(frame_phase::update);
 
-        glUniformMatrix4fv(view_location, 1, GL_FALSE, glm::value_ptr(view));
+        profile_begin("cull");
 
-        glUniform1i(type_location, 1);
+        /* The draws of one state go front to back, by their nearest instance */
+        float platform_depth = far_plane;
+        float tree_depth = far_plane;
+        float ferrari_depth = far_plane;
+        float gizmo_depth = far_plane;
 
-        glm::vec3 platform_color{ 0.7f, 0.7f, 0.7f };
-        glUniform3fv(cubecolor_location, 1, glm::value_ptr(platform_color));
+        objects.clear();
+        culling.clear();
 
-        glBindVertexArray(cube_vao);
-        transform platform{ {0.0f, -4.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {100.0f, 0.1f, 100.0f} };
-        render_transform(platform, model_location, normal_location);
-        glDrawArrays(GL_TRIANGLES, 0, n_vertices);
+        glm::mat4 view_proj = projection * view;
 
-        for (int i = 0; i < lights.size(); ++i) {
-            lights[i].update();
+        for (uint32_t i = 0; i < ferraris.size(); ++i)
+            transforms.set(first_ferrari + i, ferraris[i]);
+        transforms.update();
+        transforms.compute_mvp(view_proj);
+
+        gizmo_transforms.clear();
+        for (const auto &l : lights)
+            gizmo_transforms.add(transform{ l.position, glm::vec3{ 0.0f }, glm::vec3{ 0.2f } });
+        gizmo_transforms.update();
+        gizmo_transforms.compute_mvp(view_proj);
+
+        /* Pixels covered by one unit one unit away from the viewer */
+        const float pixels_per_radian = fb_height / (2.0f * std::tan(fov / 2.0f));
+
+        auto add_object = [&](instance_batch &batch, float &nearest, const gpu_mesh &mesh,
+                              const transform_batch &source, uint32_t i, glm::vec3 color, uint32_t *lod_state) {
+            const glm::mat4 &model = source.model(i);
+            float depth = source.mvp(i)[3].w;
+
+            uint32_t lod = 0;
+            if (lod_state && lod_enabled) {
+                float scale = std::sqrt(std::max({ glm::dot(glm::vec3{ model[0] }, glm::vec3{ model[0] }),
+                                                   glm::dot(glm::vec3{ model[1] }, glm::vec3{ model[1] }),
+                                                   glm::dot(glm::vec3{ model[2] }, glm::vec3{ model[2] }) }));
+                float distance = std::max(depth - mesh.bounds.radius * scale, near_plane);
+
+                lod = *lod_state = select_lod(mesh, scale * pixels_per_radian / distance, lod_threshold, *lod_state);
+            }
+
+            culling.add(mesh.bounds.center, mesh.bounds.radius, model);
+            objects.push_back({ &batch, &nearest, model, source.normal(i), color, depth, lod, triangle_count(mesh, lod) });
+        };
+
+        add_object(platform_batch, platform_depth, cube_mesh, transforms, platform_id, glm::vec3{ 0.7f, 0.7f, 0.7f },
+                   &object_lods[platform_id]);
+        add_object(tree_batch, tree_depth, tree_mesh, transforms, tree_id, glm::vec3{ 1.0f }, &object_lods[tree_id]);
+        for (uint32_t i = 0; i < ferraris.size(); ++i) {
+            add_object(ferrari_batch, ferrari_depth, ferrari_mesh, transforms, first_ferrari + i, glm::vec3{ 1.0f },
+                       &object_lods[first_ferrari + i]);
         }
+        for (uint32_t i = 0; i < lights.size(); ++i)
+            add_object(gizmo_batch, gizmo_depth, gizmo_mesh, gizmo_transforms, i, lights[i].color, nullptr);
 
-        glUniform1i(type_location, 2);
+        auto cull_start = std::chrono::high_resolution_clock::now();
 
-        for (int i = 0; i < lights.size(); ++i) {
-            lights[i].draw(model_location);
+        if (cull) {
+            culling.cull(extract_frustum(view_proj), visible);
+        } else {
+            visible.resize(objects.size());
+            for (uint32_t i = 0; i < visible.size(); ++i)
+                visible[i] = i;
         }
 
-        glUniform1i(type_location, 0);
+        cull_time = std::chrono::high_resolution_clock::now() - cull_start;
+
+        profile_end();
+
+        if (benchmark)
+            benchmark->end_phase(frame_phase::cull);
+
+        profile_begin("batch");
 
-        glBindVertexArray(vao);
+        /* Front to back inside each batch too, the instances are drawn in push order */
+        std::sort(visible.begin(), visible.end(), [&](uint32_t a, uint32_t b) {
+            return objects[a].depth < objects[b].depth;
+        });
 
-        glUniform1i(texture_location, 0);
+        platform_batch.clear();
+        tree_batch.clear();
+        ferrari_batch.clear();
+        gizmo_batch.clear();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        triangles_drawn = 0;
 
-        for (int i = 0; i < ferraris.size(); ++i) {
-            render_transform(ferraris[i], model_location, normal_location);
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, NULL);
+        for (uint32_t i : visible) {
+            const scene_object &object = objects[i];
+            object.batch->push(object.model, object.normal, object.color, object.lod);
+
+            *object.nearest = std::min(*object.nearest, object.depth);
+            triangles_drawn += object.triangles;
         }
 
-        glUniform1i(texture_location, 1);
-        
-        glBindVertexArray(tree_vao);
-        
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tree_ibo);
+        platform_batch.upload();
+        tree_batch.upload();
+        ferrari_batch.upload();
+        gizmo_batch.upload();
+
+        profile_end();
+
+        if (benchmark)
+            benchmark->end_phase(frame_phase::batch);
+
+        profile_begin("render");
+
+        queue.clear();
+
+        if (prepass) {
+            queue.submit(render_pass::depth, depth_program.get(), cube_mesh, platform_batch, 0, platform_depth, "platform");
+            queue.submit(render_pass::depth, depth_program.get(), ferrari_mesh, ferrari_batch, 0, ferrari_depth, "ferrari");
+            queue.submit(render_pass::depth, depth_program.get(), tree_mesh, tree_batch, 0, tree_depth, "tree");
+        }
+
+        /* Either texture may still be the placeholder, so they are looked up every frame */
+        queue.submit(render_pass::opaque, variant_for(cube_mesh, true, false), cube_mesh, platform_batch, 0, platform_depth,
+            "platform");
+        queue.submit(render_pass::opaque, variant_for(ferrari_mesh, true, true), ferrari_mesh, ferrari_batch,
+            textures.get(ferrari_tex), ferrari_depth, "ferrari");
+        bool tree_textured = tree_mesh.submeshes.empty();
+        queue.submit(render_pass::opaque, variant_for(tree_mesh, true, tree_textured), tree_mesh, tree_batch,
+            tree_textured ? textures.get(tree_tex) : 0, tree_depth, "tree");
+        queue.submit(render_pass::unlit, variant_for(gizmo_mesh, false, false), gizmo_mesh, gizmo_batch, 0, gizmo_depth,
+            "gizmo");
+
+        /* A minimized window has a 0x0 framebuffer, a G-buffer that size can't be complete */
+        bool deferred_frame = deferred_shading && fb_width > 0 && fb_height > 0;
+
+        if (deferred_frame) {
+            deferred.resize(fb_width, fb_height);
+            deferred.begin(clear_color);
+        }
 
-        render_transform(tree, model_location, normal_location);
-        glDrawElements(GL_TRIANGLES, tree_ind.size(), GL_UNSIGNED_INT, NULL);
+        queue.execute(&gpu_times);
 
-        if (start) {
+        if (deferred_frame) {
+            profile_scope shade{ "deferred shade" };
+            gpu_times.begin("deferred shade");
+            deferred.shade(lighting_variant(), view_proj, gbuffer_unit);
+            gpu_times.end();
+        }
+
+        profile_end();
+
+        if (benchmark)
+            benchmark->end_phase(frame_phase::draw);
+
+        profile_begin("animation");
+
+        if (start && !scene) {
             for (int i = 0; i < ferraris.size(); ++i) {
                 fangles[i] += 0.03 * dt.count() / 10000;
 
@@ -737,12 +1090,30 @@ void run_main_loop(GLFWwindow* window, uint32_t program, uint32_t cube_vao, uint
             }
         }
 
+        profile_end();
+
+        profile_begin("imgui draw");
         ImGui::Render();
         
+        gpu_times.begin("imgui");
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        gpu_times.end();
+        profile_end();
 
+        profile_begin("swap");
         glfwSwapBuffers(window);
+        profile_end();
 
         dt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_frame_ts);
+
+        /* Animations advance by the same step every frame, so every run draws the same frames */
+        if (benchmark) {
+            benchmark->end_phase(frame_phase::present);
+            benchmark->end_frame(queue.stats(), triangles_drawn, gpu_times);
+
+            dt = frame_benchmark::frame_step;
+        }
+
+        frame_profiler.end_frame();
     }
 }
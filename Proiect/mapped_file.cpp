@@ -0,0 +1,133 @@
+#include "mapped_file.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::filesystem::path &path) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw mapping_error(path);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw mapping_error(path);
+    }
+
+    file_ = file;
+    size_ = (size_t)size.QuadPart;
+
+    /* Empty files can't be mapped, they are represented by a null view */
+    if (!size_)
+        return;
+
+    mapping_ = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_) {
+        close();
+        throw mapping_error(path);
+    }
+
+    data_ = (const uint8_t *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!data_) {
+        close();
+        throw mapping_error(path);
+    }
+}
+
+
+void mapped_file::close() {
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_)
+        CloseHandle(file_);
+
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+mapped_file::mapped_file(const std::filesystem::path &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw mapping_error(path);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        throw mapping_error(path);
+    }
+
+    size_ = (size_t)st.st_size;
+
+    if (size_) {
+        void *data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            throw mapping_error(path);
+        }
+
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = (const uint8_t *)data;
+    }
+
+    /* The mapping keeps its own reference to the file */
+    ::close(fd);
+}
+
+
+void mapped_file::close() {
+    if (data_)
+        munmap((void *)data_, size_);
+
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+
+mapped_file::~mapped_file() {
+    close();
+}
+
+
+mapped_file::mapped_file(mapped_file &&other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(file_, other.file_);
+    std::swap(mapping_, other.mapping_);
+#endif
+}
+
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept {
+    close();
+
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(file_, other.file_);
+    std::swap(mapping_, other.mapping_);
+#endif
+
+    return *this;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+
+struct mapping_error : public std::exception {
+    mapping_error(const std::filesystem::path &path) : message_("Failed to map file: " + path.string()) {}
+
+    const char *what() const noexcept override { return message_.c_str(); }
+
+private:
+    std::string message_;
+};
+
+
+/* Read only view of a whole file mapped into memory */
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path &path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &other) = delete;
+    mapped_file &operator=(const mapped_file &other) = delete;
+
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file &operator=(mapped_file &&other) noexcept;
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void close();
+
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
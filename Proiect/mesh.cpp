@@ -0,0 +1,280 @@
+#include "mesh.h"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+
+static glm::vec2 octahedral_encode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+    if (n.z < 0.0f) {
+        glm::vec2 sign{ n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f };
+
+        return (1.0f - glm::abs(glm::vec2{ n.y, n.x })) * sign;
+    }
+
+    return glm::vec2{ n.x, n.y };
+}
+
+
+static std::vector<packed_vertex> pack_vertices(const loader::vertex *vertices, size_t vertex_count,
+                                                const loader::mesh_bounds &bounds, glm::mat4 &dequantize) {
+    glm::vec3 lo = bounds.min;
+    glm::vec3 extent = bounds.max - bounds.min;
+    dequantize = glm::translate(lo) * glm::scale(extent);
+
+    glm::vec3 to_unit{
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f,
+    };
+
+    std::vector<packed_vertex> packed(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i) {
+        const loader::vertex &v = vertices[i];
+        packed_vertex &p = packed[i];
+
+        glm::vec3 unit = (v.position - lo) * to_unit;
+        for (int c = 0; c < 3; ++c)
+            p.position[c] = (uint16_t)glm::packUnorm1x16(unit[c]);
+        p.pad = 0;
+
+        float length = glm::length(v.normal);
+        glm::vec2 oct = length > 0.0f ? octahedral_encode(v.normal / length) : glm::vec2{ 0.0f };
+        p.normal[0] = (int16_t)glm::packSnorm1x16(oct.x);
+        p.normal[1] = (int16_t)glm::packSnorm1x16(oct.y);
+
+        p.uvs[0] = glm::packHalf1x16(v.uvs.x);
+        p.uvs[1] = glm::packHalf1x16(v.uvs.y);
+    }
+
+    return packed;
+}
+
+
+static void upload_positions(const gpu_mesh &mesh, const void *data, size_t size, GLenum type, GLboolean normalized, GLsizei stride) {
+    glBindVertexArray(mesh.depth_vao.get());
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.position_vbo.get());
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, type, normalized, stride, (const void *)0);
+
+    /* Shares the index buffer, its contents are uploaded afterwards */
+    if (mesh.index_count)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo.get());
+}
+
+
+gpu_mesh upload_mesh(const loader::vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+                     const loader::mesh_bounds &bounds, vertex_format format, const glm::vec3 *positions) {
+    gpu_mesh mesh{
+        vertex_array_t{ gen_vertex_array() },
+        buffer_t{ gen_buffer() },
+        buffer_t{ gen_buffer() },
+        vertex_array_t{ gen_vertex_array() },
+        buffer_t{ gen_buffer() },
+        format,
+        (uint32_t)vertex_count,
+        (uint32_t)index_count,
+        GL_UNSIGNED_INT,
+        glm::mat4{ 1.0f },
+        glm::mat3{ 1.0f },
+        bounds,
+        { loader::mesh_lod{ 0, (uint32_t)index_count, 0.0f } },
+        {},
+    };
+
+    glBindVertexArray(mesh.vao.get());
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo.get());
+
+    if (format == vertex_format::packed) {
+        auto packed = pack_vertices(vertices, vertex_count, bounds, mesh.dequantize);
+
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(packed_vertex), packed.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_vertex), (const void *)offsetof(packed_vertex, position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(packed_vertex), (const void *)offsetof(packed_vertex, normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(packed_vertex), (const void *)offsetof(packed_vertex, uvs));
+
+        /* The first 8 bytes of a packed vertex are already the position with its padding */
+        std::vector<uint16_t> packed_positions(4 * vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i)
+            std::memcpy(&packed_positions[4 * i], &packed[i].position, 4 * sizeof(uint16_t));
+
+        upload_positions(mesh, packed_positions.data(), packed_positions.size() * sizeof(uint16_t),
+                         GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(uint16_t));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(loader::vertex), vertices, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(loader::vertex), (const void *)offsetof(loader::vertex, position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(loader::vertex), (const void *)offsetof(loader::vertex, normal));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(loader::vertex), (const void *)offsetof(loader::vertex, uvs));
+
+        std::vector<glm::vec3> gathered;
+        if (!positions) {
+            gathered.reserve(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i)
+                gathered.push_back(vertices[i].position);
+
+            positions = gathered.data();
+        }
+
+        upload_positions(mesh, positions, vertex_count * sizeof(glm::vec3), GL_FLOAT, GL_FALSE, sizeof(glm::vec3));
+    }
+
+    /* Back to the main VAO, the index buffer binding below is recorded in it */
+    glBindVertexArray(mesh.vao.get());
+
+    if (index_count) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo.get());
+
+        /* Scene indices are relative to each submesh, so only the largest one tells */
+        bool fits_short = vertex_count <= std::numeric_limits<uint16_t>::max() + 1
+            || *std::max_element(indices, indices + index_count) <= std::numeric_limits<uint16_t>::max();
+
+        if (fits_short) {
+            std::vector<uint16_t> short_indices(indices, indices + index_count);
+
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+            mesh.index_type = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        }
+    }
+
+    glBindVertexArray(0);
+
+    return mesh;
+}
+
+
+gpu_mesh upload_mesh(const loader::gltf_primitive &primitive) {
+    if (primitive.normals.empty()) {
+        std::vector<loader::vertex> vertices;
+        std::vector<unsigned int> indices;
+        loader::append_primitive(primitive, vertices, indices);
+
+        return upload_mesh(vertices.data(), vertices.size(), indices.data(), indices.size(), primitive.bounds, vertex_format::full);
+    }
+
+    const loader::gltf_stream &positions = primitive.positions;
+    const loader::gltf_stream &normals = primitive.normals;
+    const loader::gltf_stream &uvs = primitive.uvs;
+    const loader::gltf_stream &indices = primitive.indices;
+
+    /* The transform holds the z mirror out of glTF's right handed space. It turns the winding
+     * around too, which nothing culls by. */
+    gpu_mesh mesh{
+        vertex_array_t{ gen_vertex_array() },
+        buffer_t{ gen_buffer() },
+        buffer_t{ gen_buffer() },
+        vertex_array_t{ gen_vertex_array() },
+        buffer_t{ gen_buffer() },
+        vertex_format::full,
+        (uint32_t)positions.count,
+        (uint32_t)indices.count,
+        indices.component_type == loader::gltf_unsigned_int ? (uint32_t)GL_UNSIGNED_INT : (uint32_t)GL_UNSIGNED_SHORT,
+        primitive.transform,
+        glm::transpose(glm::inverse(glm::mat3{ primitive.transform })),
+        primitive.bounds,
+        { loader::mesh_lod{ 0, (uint32_t)indices.count, 0.0f } },
+        {},
+    };
+
+    /* The positions are the depth VAO's stream as they are, the main VAO reads them from there too */
+    upload_positions(mesh, positions.data, positions.span(), GL_FLOAT, GL_FALSE, (GLsizei)positions.stride);
+
+    glBindVertexArray(mesh.vao.get());
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)positions.stride, (const void *)0);
+
+    /* Normals then uvs, each span copied in as is. Without uvs location 2 stays disabled and
+     * reads the default (0, 0). */
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo.get());
+    glBufferData(GL_ARRAY_BUFFER, normals.span() + uvs.span(), NULL, GL_STATIC_DRAW);
+
+    glBufferSubData(GL_ARRAY_BUFFER, 0, normals.span(), normals.data);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (GLsizei)normals.stride, (const void *)0);
+
+    if (!uvs.empty()) {
+        glBufferSubData(GL_ARRAY_BUFFER, normals.span(), uvs.span(), uvs.data);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, uvs.component_type, uvs.normalized ? GL_TRUE : GL_FALSE, (GLsizei)uvs.stride,
+                              (const void *)normals.span());
+    }
+
+    if (!indices.empty()) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo.get());
+
+        if (indices.component_type == loader::gltf_unsigned_byte) {
+            std::vector<uint16_t> short_indices(indices.count);
+            for (size_t i = 0; i < indices.count; ++i)
+                short_indices[i] = (uint16_t)indices.index(i);
+
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+        } else if (indices.stride == indices.element_size()) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.span(), indices.data, GL_STATIC_DRAW);
+        } else {
+            /* Strided indices aren't valid glTF, but cost nothing to support */
+            std::vector<uint32_t> gathered(indices.count);
+            for (size_t i = 0; i < indices.count; ++i)
+                gathered[i] = indices.index(i);
+
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, gathered.size() * sizeof(uint32_t), gathered.data(), GL_STATIC_DRAW);
+            mesh.index_type = GL_UNSIGNED_INT;
+        }
+    }
+
+    glBindVertexArray(0);
+
+    return mesh;
+}
+
+
+uint32_t select_lod(const gpu_mesh &mesh, float pixels_per_unit, float threshold, uint32_t current, float hysteresis) {
+    uint32_t lod = 0;
+
+    /* The errors grow with the level, so the first one over the limit ends the search */
+    for (uint32_t i = 1; i < mesh.lods.size(); ++i) {
+        float limit = i > current ? threshold * hysteresis : threshold;
+        if (mesh.lods[i].error * pixels_per_unit > limit)
+            break;
+
+        lod = i;
+    }
+
+    return lod;
+}
+
+
+uint32_t triangle_count(const gpu_mesh &mesh, uint32_t lod) {
+    if (!mesh.index_count)
+        return mesh.vertex_count / 3;
+
+    if (!mesh.submeshes.empty()) {
+        uint32_t triangles = 0;
+        for (const loader::submesh &part : mesh.submeshes)
+            triangles += part.index_count / 3;
+
+        return triangles;
+    }
+
+    return mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)].index_count / 3;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include "loader.h"
+#include "gltf.h"
+#include "scene_import.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+
+enum class vertex_format {
+    /* loader::vertex as is, 32 bytes */
+    full,
+    /* packed_vertex, 16 bytes */
+    packed,
+};
+
+
+/* Position quantized to 16 bits inside the mesh bounds, octahedron encoded normal
+ * and half float uvs. The bounds are undone by gpu_mesh::dequantize. */
+struct packed_vertex {
+    uint16_t position[3];
+    uint16_t pad;
+    int16_t normal[2];
+    uint16_t uvs[2];
+};
+
+static_assert(sizeof(packed_vertex) == 16, "packed_vertex must stay 16 bytes");
+
+
+/* Vertex and index buffers of a mesh with the VAO describing them. Attribute
+ * locations 0 to 2 are the ones vertex.glsl reads position, normal and uvs from.
+ * depth_vao reads only the positions, from a stream of their own, and shares the
+ * index buffer; depth_vertex.glsl draws with it. */
+struct gpu_mesh {
+    vertex_array_t vao;
+    buffer_t vbo;
+    buffer_t ibo;
+
+    vertex_array_t depth_vao;
+    /* 12 bytes a vertex for full meshes, 8 for packed ones */
+    buffer_t position_vbo;
+
+    vertex_format format;
+
+    uint32_t vertex_count;
+    uint32_t index_count;
+    /* GL_UNSIGNED_SHORT whenever every index fits */
+    uint32_t index_type;
+
+    /* Maps the quantized [0, 1] positions back into model space, identity for full vertices.
+     * Meshes drawn straight from glTF buffers get their node transform and z mirror here. */
+    glm::mat4 dequantize;
+    /* The same for the normals, the inverse transpose of a glTF mesh's transform */
+    glm::mat3 normal_dequantize;
+
+    /* In model space, before dequantize */
+    loader::mesh_bounds bounds;
+
+    /* Ranges of the index buffer, a single level covering it unless the mesh came with more */
+    std::vector<loader::mesh_lod> lods;
+
+    /* Meshes of an imported scene sharing the buffers, empty for a single mesh */
+    std::vector<loader::submesh> submeshes;
+};
+
+
+/* positions is the position only stream of full meshes, it is gathered from the vertices
+ * when NULL. Packed meshes always take theirs from the quantized vertices, so both
+ * passes see bit identical positions. */
+gpu_mesh upload_mesh(const loader::vertex *vertices, size_t vertex_count, const unsigned int *indices, size_t index_count,
+                     const loader::mesh_bounds &bounds, vertex_format format, const glm::vec3 *positions = NULL);
+
+/* Coarsest level of detail whose error, projected to pixels, stays under threshold.
+ * pixels_per_unit converts a model space distance at the object's depth to pixels.
+ * Against popping back and forth, a level coarser than current is only taken once
+ * its error is under threshold * hysteresis. */
+uint32_t select_lod(const gpu_mesh &mesh, float pixels_per_unit, float threshold, uint32_t current, float hysteresis = 0.75f);
+
+/* Triangles drawn per instance at a level of detail, all submeshes together */
+uint32_t triangle_count(const gpu_mesh &mesh, uint32_t lod);
+
+
+/* Full format mesh drawing the primitive's streams where they lie in the glTF binary chunk:
+ * each is handed to glBufferData straight from the mapping and the attribute pointers take
+ * the accessor types and strides. Primitives without normals are copied out with
+ * append_primitive instead, to generate them. Byte indices are widened to shorts. */
+gpu_mesh upload_mesh(const loader::gltf_primitive &primitive);
+
+
+inline gpu_mesh upload_mesh(const loader::mesh_data &mesh, vertex_format format) {
+    gpu_mesh result = upload_mesh(mesh.vertex_data(), mesh.vertex_count(), mesh.index_data(), mesh.index_count(), mesh.bounds(),
+                                  format, mesh.position_data());
+    result.lods = mesh.lods();
+
+    return result;
+}
+
+
+/* The scene's indices restart from 0 in every submesh, so they stay 16 bits as long as
+ * no single submesh has more than 65536 vertices */
+inline gpu_mesh upload_mesh(const loader::scene_data &scene, vertex_format format) {
+    gpu_mesh result = upload_mesh(scene.vertices.data(), scene.vertices.size(), scene.indices.data(), scene.indices.size(),
+                                  scene.bounds, format);
+    result.submeshes = scene.submeshes;
+
+    return result;
+}
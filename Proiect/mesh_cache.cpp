@@ -0,0 +1,172 @@
+#include "mesh_cache.h"
+#include "hash.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+namespace loader {
+
+struct cache_header {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t vertex_size;
+	uint32_t index_size;
+	uint64_t vertex_count;
+	uint64_t vertex_offset;
+	uint64_t position_offset;
+	uint64_t index_count;
+	uint64_t index_offset;
+	mesh_bounds bounds;
+	uint32_t lod_count;
+	mesh_lod lods[max_lods];
+};
+
+static_assert(sizeof(cache_header) <= cache_page_size, "The cache header must fit in its page");
+
+static const char cache_magic[4] = { 'L', 'M', 'S', 'H' };
+
+
+static uint64_t align_to_page(uint64_t offset) {
+	return (offset + cache_page_size - 1) / cache_page_size * cache_page_size;
+}
+
+
+uint64_t cache_key(const mapped_file &source, uint32_t import_flags) {
+	uint64_t key = hash_bytes(source.data(), source.size());
+
+	key = hash_bytes(&import_flags, sizeof(import_flags), key);
+
+	uint32_t version = cache_version;
+	key = hash_bytes(&version, sizeof(version), key);
+
+	return key;
+}
+
+
+std::filesystem::path cache_path(const std::filesystem::path &source, uint64_t key) {
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+
+	return std::filesystem::path{ "cache" } / (source.filename().string() + "." + hex + ".mesh");
+}
+
+
+/* Whether count elements from offset lie inside the file, without offset + count * size
+ * wrapping around for corrupt values */
+static bool array_fits(uint64_t offset, uint64_t count, size_t element_size, size_t file_size) {
+	return offset <= file_size && count <= (file_size - offset) / element_size;
+}
+
+
+std::optional<mesh_data> read_cache(const std::filesystem::path &path, uint64_t key) {
+	std::error_code ec;
+	if (!std::filesystem::exists(path, ec))
+		return std::nullopt;
+
+	try {
+		mapped_file file{ path };
+
+		if (file.size() < sizeof(cache_header))
+			return std::nullopt;
+
+		cache_header header;
+		std::memcpy(&header, file.data(), sizeof(header));
+
+		bool valid = std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0
+			&& header.version == cache_version
+			&& header.key == key
+			&& header.vertex_size == sizeof(vertex)
+			&& header.index_size == sizeof(unsigned int)
+			&& header.vertex_offset % cache_page_size == 0
+			&& header.position_offset % cache_page_size == 0
+			&& header.index_offset % cache_page_size == 0
+			&& array_fits(header.vertex_offset, header.vertex_count, sizeof(vertex), file.size())
+			&& array_fits(header.position_offset, header.vertex_count, sizeof(glm::vec3), file.size())
+			&& array_fits(header.index_offset, header.index_count, sizeof(unsigned int), file.size())
+			&& header.lod_count >= 1 && header.lod_count <= max_lods;
+
+		/* The draws trust the ranges, one reaching past the index array would read past the buffer on the GPU */
+		for (uint32_t i = 0; valid && i < header.lod_count; ++i)
+			valid = (uint64_t)header.lods[i].index_offset + header.lods[i].index_count <= header.index_count;
+
+		if (!valid) {
+			spdlog::warn("Ignoring stale or corrupt cache entry {}", path.string());
+			return std::nullopt;
+		}
+
+		auto vertices = (const vertex *)(file.data() + header.vertex_offset);
+		auto positions = (const glm::vec3 *)(file.data() + header.position_offset);
+		auto indices = (const unsigned int *)(file.data() + header.index_offset);
+
+		std::vector<mesh_lod> lods(header.lods, header.lods + header.lod_count);
+
+		return mesh_data{ std::move(file), vertices, positions, header.vertex_count, indices, header.index_count, header.bounds,
+			std::move(lods) };
+	} catch (const mapping_error &ex) {
+		spdlog::warn("{}", ex.what());
+		return std::nullopt;
+	}
+}
+
+
+void write_cache(const std::filesystem::path &path, uint64_t key, const mesh_data &mesh) {
+	const uint64_t vertex_bytes = mesh.vertex_count() * sizeof(vertex);
+	const uint64_t position_bytes = mesh.vertex_count() * sizeof(glm::vec3);
+
+	cache_header header{};
+	std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.key = key;
+	header.vertex_size = sizeof(vertex);
+	header.index_size = sizeof(unsigned int);
+	header.vertex_count = mesh.vertex_count();
+	header.vertex_offset = cache_page_size;
+	header.position_offset = align_to_page(header.vertex_offset + vertex_bytes);
+	header.index_count = mesh.index_count();
+	header.index_offset = align_to_page(header.position_offset + position_bytes);
+	header.bounds = mesh.bounds();
+	header.lod_count = (uint32_t)std::min(mesh.lods().size(), max_lods);
+	std::copy(mesh.lods().begin(), mesh.lods().begin() + header.lod_count, header.lods);
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	/* Written under a temporary name and renamed, so a crash never leaves a truncated entry behind */
+	auto tmp_path = path;
+	tmp_path += ".tmp";
+
+	{
+		std::ofstream out{ tmp_path, std::ios::binary | std::ios::trunc };
+
+		std::vector<char> page(cache_page_size, 0);
+		std::memcpy(page.data(), &header, sizeof(header));
+		out.write(page.data(), page.size());
+
+		std::fill(page.begin(), page.end(), 0);
+
+		out.write((const char *)mesh.vertex_data(), vertex_bytes);
+		out.write(page.data(), header.position_offset - (header.vertex_offset + vertex_bytes));
+
+		out.write((const char *)mesh.position_data(), position_bytes);
+		out.write(page.data(), header.index_offset - (header.position_offset + position_bytes));
+
+		out.write((const char *)mesh.index_data(), mesh.index_count() * sizeof(unsigned int));
+
+		if (!out) {
+			spdlog::warn("Failed to write cache entry {}", path.string());
+			std::filesystem::remove(tmp_path, ec);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec) {
+		spdlog::warn("Failed to write cache entry {}: {}", path.string(), ec.message());
+		std::filesystem::remove(tmp_path, ec);
+	}
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+#include "loader.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+
+namespace loader {
+
+/* Cache entries are laid out as a header page followed by the vertex, the position and
+ * the index arrays, each starting on a page boundary so they can be used in place once mapped. */
+constexpr size_t cache_page_size = 4096;
+
+/* Bump whenever the loader changes what it produces for the same input */
+constexpr uint32_t cache_version = 8;
+
+/* Identifies the contents of a source asset together with the settings it is imported with */
+uint64_t cache_key(const mapped_file &source, uint32_t import_flags);
+
+std::filesystem::path cache_path(const std::filesystem::path &source, uint64_t key);
+
+std::optional<mesh_data> read_cache(const std::filesystem::path &path, uint64_t key);
+
+/* Failures are only logged, the asset has been loaded anyway */
+void write_cache(const std::filesystem::path &path, uint64_t key, const mesh_data &mesh);
+
+}
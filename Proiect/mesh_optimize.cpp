@@ -0,0 +1,374 @@
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+
+namespace loader {
+
+/* FIFO post-transform cache, only misses push vertices in so a vertex is
+ * still cached while fewer than vertex_cache_size misses came after it */
+class fifo_cache {
+public:
+	explicit fifo_cache(size_t vertex_count) : inserted_(vertex_count, 0) {}
+
+	bool access(unsigned int v) {
+		if (time_ - inserted_[v] < vertex_cache_size)
+			return true;
+
+		inserted_[v] = time_++;
+		return false;
+	}
+
+	void flush() { time_ += vertex_cache_size + 1; }
+
+private:
+	std::vector<uint32_t> inserted_;
+	uint32_t time_ = vertex_cache_size + 1;
+};
+
+
+static float analyze_overdraw(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices) {
+	const int grid = 256;
+
+	glm::vec3 lo{ std::numeric_limits<float>::max() };
+	glm::vec3 hi{ std::numeric_limits<float>::lowest() };
+	for (unsigned int i : indices) {
+		lo = glm::min(lo, vertices[i].position);
+		hi = glm::max(hi, vertices[i].position);
+	}
+
+	float extent = std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z });
+	if (extent <= 0.0f)
+		return 1.0f;
+
+	float scale = (grid - 1) / extent;
+
+	std::vector<float> depth(grid * grid);
+	size_t covered = 0;
+	size_t shaded = 0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		int u_axis = (axis + 1) % 3;
+		int v_axis = (axis + 2) % 3;
+
+		for (float direction : { 1.0f, -1.0f }) {
+			std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				glm::vec3 p[3];
+				for (int k = 0; k < 3; ++k) {
+					glm::vec3 v = (vertices[indices[t + k]].position - lo) * scale;
+					p[k] = glm::vec3{ v[u_axis], v[v_axis], direction * v[axis] };
+				}
+
+				float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+				if (area == 0.0f)
+					continue;
+				if (area < 0.0f) {
+					std::swap(p[1], p[2]);
+					area = -area;
+				}
+
+				int x0 = std::max(0, (int)std::ceil(std::min({ p[0].x, p[1].x, p[2].x }) - 0.5f));
+				int x1 = std::min(grid - 1, (int)std::floor(std::max({ p[0].x, p[1].x, p[2].x }) - 0.5f));
+				int y0 = std::max(0, (int)std::ceil(std::min({ p[0].y, p[1].y, p[2].y }) - 0.5f));
+				int y1 = std::min(grid - 1, (int)std::floor(std::max({ p[0].y, p[1].y, p[2].y }) - 0.5f));
+
+				for (int y = y0; y <= y1; ++y) {
+					for (int x = x0; x <= x1; ++x) {
+						float px = x + 0.5f;
+						float py = y + 0.5f;
+
+						float w0 = (p[2].x - p[1].x) * (py - p[1].y) - (p[2].y - p[1].y) * (px - p[1].x);
+						float w1 = (p[0].x - p[2].x) * (py - p[2].y) - (p[0].y - p[2].y) * (px - p[2].x);
+						float w2 = (p[1].x - p[0].x) * (py - p[0].y) - (p[1].y - p[0].y) * (px - p[0].x);
+						if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+							continue;
+
+						float z = (w0 * p[0].z + w1 * p[1].z + w2 * p[2].z) / area;
+
+						float &d = depth[y * grid + x];
+						if (z < d) {
+							if (d == std::numeric_limits<float>::max())
+								++covered;
+
+							d = z;
+							++shaded;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return covered ? (float)shaded / covered : 1.0f;
+}
+
+
+mesh_metrics analyze_mesh(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices) {
+	fifo_cache cache{ vertices.size() };
+	std::vector<bool> referenced(vertices.size(), false);
+
+	size_t misses = 0;
+	size_t unique = 0;
+	for (unsigned int i : indices) {
+		if (!cache.access(i))
+			++misses;
+
+		if (!referenced[i]) {
+			referenced[i] = true;
+			++unique;
+		}
+	}
+
+	size_t triangles = indices.size() / 3;
+
+	return mesh_metrics{
+		triangles ? (float)misses / triangles : 0.0f,
+		unique ? (float)misses / unique : 0.0f,
+		analyze_overdraw(vertices, indices),
+	};
+}
+
+
+std::vector<size_t> optimize_vertex_cache(std::vector<unsigned int> &indices, size_t vertex_count) {
+	const size_t n_triangles = indices.size() / 3;
+	const int k = (int)vertex_cache_size;
+
+	/* Triangles around every vertex, packed as offsets into one array */
+	std::vector<uint32_t> live(vertex_count, 0);
+	for (unsigned int i : indices)
+		++live[i];
+
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < n_triangles; ++t) {
+			for (int c = 0; c < 3; ++c)
+				adjacency[fill[indices[3 * t + c]]++] = (uint32_t)t;
+		}
+	}
+
+	std::vector<int> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(n_triangles, false);
+	std::vector<unsigned int> dead_end;
+	std::vector<unsigned int> candidates;
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	std::vector<size_t> hard_boundaries;
+
+	int time = k + 1;
+	size_t cursor = 0;
+
+	auto skip_dead_end = [&]() -> long long {
+		while (!dead_end.empty()) {
+			unsigned int d = dead_end.back();
+			dead_end.pop_back();
+
+			if (live[d] > 0)
+				return d;
+		}
+
+		while (cursor < vertex_count) {
+			if (live[cursor] > 0)
+				return (long long)cursor++;
+
+			++cursor;
+		}
+
+		return -1;
+	};
+
+	long long fanning = skip_dead_end();
+
+	while (fanning >= 0) {
+		candidates.clear();
+
+		for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int c = 0; c < 3; ++c) {
+				unsigned int v = indices[3 * t + c];
+
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+
+				--live[v];
+
+				if (time - cache_time[v] > k)
+					cache_time[v] = time++;
+			}
+
+			emitted[t] = true;
+		}
+
+		/* Next fanning vertex: a candidate that will still be in the cache after its
+		 * remaining triangles are emitted, the one that entered it earliest */
+		long long next = -1;
+		int best = -1;
+		for (unsigned int v : candidates) {
+			if (!live[v])
+				continue;
+
+			int priority = 0;
+			if (time - cache_time[v] + 2 * (int)live[v] <= k)
+				priority = time - cache_time[v];
+
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1) {
+			next = skip_dead_end();
+			if (next >= 0)
+				hard_boundaries.push_back(output.size() / 3);
+		}
+
+		fanning = next;
+	}
+
+	indices = std::move(output);
+
+	return hard_boundaries;
+}
+
+
+void optimize_overdraw(std::vector<unsigned int> &indices, const std::vector<vertex> &vertices,
+	const std::vector<size_t> &hard_boundaries, float threshold) {
+	const size_t n_triangles = indices.size() / 3;
+	if (!n_triangles)
+		return;
+
+	size_t misses = 0;
+	fifo_cache cache{ vertices.size() };
+	for (unsigned int i : indices)
+		misses += !cache.access(i);
+
+	const float acmr_limit = threshold * misses / n_triangles;
+
+	/* Cut at the hard boundaries, then wherever the cluster has amortized its cold cache */
+	std::vector<size_t> clusters;
+	size_t next_hard = 0;
+
+	for (size_t t = 0; t < n_triangles; ) {
+		clusters.push_back(t);
+		cache.flush();
+
+		size_t end = n_triangles;
+		while (next_hard < hard_boundaries.size() && hard_boundaries[next_hard] <= t)
+			++next_hard;
+		if (next_hard < hard_boundaries.size())
+			end = hard_boundaries[next_hard];
+
+		size_t cluster_misses = 0;
+		size_t start = t;
+		for (; t < end; ++t) {
+			for (int c = 0; c < 3; ++c)
+				cluster_misses += !cache.access(indices[3 * t + c]);
+
+			if ((float)cluster_misses / (t + 1 - start) <= acmr_limit) {
+				++t;
+				break;
+			}
+		}
+	}
+	clusters.push_back(n_triangles);
+
+	const size_t n_clusters = clusters.size() - 1;
+
+	/* Area weighted centroids, the cross products are twice the area times the normal */
+	std::vector<glm::vec3> centroid(n_clusters, glm::vec3{ 0.0f });
+	std::vector<glm::vec3> normal(n_clusters, glm::vec3{ 0.0f });
+	std::vector<float> area(n_clusters, 0.0f);
+
+	glm::vec3 mesh_centroid{ 0.0f };
+	float mesh_area = 0.0f;
+
+	for (size_t c = 0; c < n_clusters; ++c) {
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const glm::vec3 &a = vertices[indices[3 * t + 0]].position;
+			const glm::vec3 &b = vertices[indices[3 * t + 1]].position;
+			const glm::vec3 &d = vertices[indices[3 * t + 2]].position;
+
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float w = glm::length(n);
+
+			centroid[c] += (a + b + d) / 3.0f * w;
+			normal[c] += n;
+			area[c] += w;
+		}
+
+		mesh_centroid += centroid[c];
+		mesh_area += area[c];
+
+		if (area[c] > 0.0f)
+			centroid[c] /= area[c];
+	}
+
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	std::vector<float> sort_key(n_clusters, 0.0f);
+	for (size_t c = 0; c < n_clusters; ++c) {
+		float length = glm::length(normal[c]);
+		if (length > 0.0f)
+			sort_key[c] = glm::dot(centroid[c] - mesh_centroid, normal[c] / length);
+	}
+
+	std::vector<size_t> order(n_clusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return sort_key[a] > sort_key[b];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (size_t c : order)
+		output.insert(output.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+
+	indices = std::move(output);
+}
+
+
+void optimize_vertex_fetch(std::vector<vertex> &vertices, std::vector<unsigned int> &indices) {
+	const unsigned int unused = std::numeric_limits<unsigned int>::max();
+
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (unsigned int &i : indices) {
+		if (remap[i] == unused) {
+			remap[i] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[i]);
+		}
+
+		i = remap[i];
+	}
+
+	vertices = std::move(ordered);
+}
+
+
+void optimize_mesh(std::vector<vertex> &vertices, std::vector<unsigned int> &indices) {
+	auto hard_boundaries = optimize_vertex_cache(indices, vertices.size());
+
+	optimize_overdraw(indices, vertices, hard_boundaries);
+
+	optimize_vertex_fetch(vertices, indices);
+}
+
+}
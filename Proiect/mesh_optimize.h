@@ -0,0 +1,41 @@
+#pragma once
+
+
+#include "loader.h"
+#include <vector>
+
+
+namespace loader {
+
+struct mesh_metrics {
+	/* Post-transform cache misses per triangle, 0.5 is the best a regular grid can do, 3 the worst */
+	float acmr;
+	/* Cache misses per referenced vertex, 1 means every vertex is transformed once */
+	float atvr;
+	/* Fragments shaded per fragment covered, averaged over six axis aligned views */
+	float overdraw;
+};
+
+/* Size of the simulated FIFO post-transform cache */
+constexpr unsigned int vertex_cache_size = 16;
+
+mesh_metrics analyze_mesh(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices);
+
+/* Reorders triangles with Tipsify for vertex cache locality, returns the triangle indices
+ * at which it had to jump to a new area of the mesh (hard cluster boundaries). */
+std::vector<size_t> optimize_vertex_cache(std::vector<unsigned int> &indices, size_t vertex_count);
+
+/* Splits the cache optimized order into clusters and sorts the clusters so the ones
+ * facing away from the mesh center come first, which occludes more of the rest.
+ * Clusters are cut at the hard boundaries and wherever the cache miss rate of the
+ * cluster drops to threshold times the mesh average, so the cache order survives. */
+void optimize_overdraw(std::vector<unsigned int> &indices, const std::vector<vertex> &vertices,
+	const std::vector<size_t> &hard_boundaries, float threshold = 1.05f);
+
+/* Stores the vertices in the order the indices first reference them */
+void optimize_vertex_fetch(std::vector<vertex> &vertices, std::vector<unsigned int> &indices);
+
+/* All three passes above, in order */
+void optimize_mesh(std::vector<vertex> &vertices, std::vector<unsigned int> &indices);
+
+}
@@ -0,0 +1,291 @@
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+
+namespace loader {
+
+/* Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of Garland and Heckbert */
+struct quadric {
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+
+	quadric &operator+=(const quadric &o) {
+		a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+		b2 += o.b2; bc += o.bc; bd += o.bd;
+		c2 += o.c2; cd += o.cd;
+		d2 += o.d2;
+
+		return *this;
+	}
+
+	double evaluate(const glm::dvec3 &p) const {
+		return p.x * p.x * a2 + p.y * p.y * b2 + p.z * p.z * c2
+			+ 2.0 * (p.x * p.y * ab + p.x * p.z * ac + p.y * p.z * bc)
+			+ 2.0 * (p.x * ad + p.y * bd + p.z * cd)
+			+ d2;
+	}
+};
+
+
+static quadric plane_quadric(const glm::dvec3 &n, double d) {
+	quadric q;
+	q.a2 = n.x * n.x; q.ab = n.x * n.y; q.ac = n.x * n.z; q.ad = n.x * d;
+	q.b2 = n.y * n.y; q.bc = n.y * n.z; q.bd = n.y * d;
+	q.c2 = n.z * n.z; q.cd = n.z * d;
+	q.d2 = d * d;
+
+	return q;
+}
+
+
+struct collapse {
+	float cost;
+	uint32_t from;
+	uint32_t to;
+	/* Versions of both vertices when the cost was computed, stale entries are skipped */
+	uint32_t from_version;
+	uint32_t to_version;
+
+	bool operator>(const collapse &other) const { return cost > other.cost; }
+};
+
+
+std::vector<unsigned int> simplify_mesh(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices,
+	size_t target_index_count, float &error) {
+	const size_t n_vertices = vertices.size();
+	const size_t n_triangles = indices.size() / 3;
+
+	error = 0.0f;
+
+	std::vector<unsigned int> triangles(indices.begin(), indices.begin() + 3 * n_triangles);
+	std::vector<bool> dead(n_triangles, false);
+
+	std::vector<std::vector<uint32_t>> adjacency(n_vertices);
+	for (size_t t = 0; t < n_triangles; ++t) {
+		for (int c = 0; c < 3; ++c)
+			adjacency[triangles[3 * t + c]].push_back((uint32_t)t);
+	}
+
+	auto position = [&](uint32_t v) { return glm::dvec3{ vertices[v].position }; };
+
+	/* Unweighted planes, so the cost stays a squared distance. Degenerate triangles keep a zero plane. */
+	std::vector<glm::dvec4> planes(n_triangles, glm::dvec4{ 0.0 });
+	std::vector<quadric> quadrics(n_vertices);
+	for (size_t t = 0; t < n_triangles; ++t) {
+		glm::dvec3 a = position(triangles[3 * t + 0]);
+		glm::dvec3 b = position(triangles[3 * t + 1]);
+		glm::dvec3 c = position(triangles[3 * t + 2]);
+
+		glm::dvec3 n = glm::cross(b - a, c - a);
+		double length = glm::length(n);
+		if (length == 0.0)
+			continue;
+
+		n /= length;
+		planes[t] = glm::dvec4{ n, -glm::dot(n, a) };
+		quadric q = plane_quadric(n, planes[t].w);
+
+		for (int k = 0; k < 3; ++k)
+			quadrics[triangles[3 * t + k]] += q;
+	}
+
+	/* An edge used by a single triangle is open */
+	std::vector<bool> locked(n_vertices, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edges;
+		edges.reserve(3 * n_triangles);
+
+		for (size_t t = 0; t < n_triangles; ++t) {
+			for (int k = 0; k < 3; ++k) {
+				uint64_t a = triangles[3 * t + k];
+				uint64_t b = triangles[3 * t + (k + 1) % 3];
+				++edges[std::min(a, b) << 32 | std::max(a, b)];
+			}
+		}
+
+		for (const auto &[edge, count] : edges) {
+			if (count == 1) {
+				locked[edge >> 32] = true;
+				locked[edge & 0xffffffffu] = true;
+			}
+		}
+	}
+
+	std::vector<uint32_t> version(n_vertices, 0);
+	std::vector<bool> removed(n_vertices, false);
+	std::vector<uint32_t> collapsed_to(n_vertices);
+	for (uint32_t v = 0; v < n_vertices; ++v)
+		collapsed_to[v] = v;
+
+	std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>> heap;
+
+	auto push_collapse = [&](uint32_t from, uint32_t to) {
+		if (from == to || locked[from])
+			return;
+
+		quadric q = quadrics[from];
+		q += quadrics[to];
+
+		float cost = (float)std::max(0.0, q.evaluate(position(to)));
+		heap.push({ cost, from, to, version[from], version[to] });
+	};
+
+	for (size_t t = 0; t < n_triangles; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			uint32_t a = triangles[3 * t + k];
+			uint32_t b = triangles[3 * t + (k + 1) % 3];
+
+			push_collapse(a, b);
+			push_collapse(b, a);
+		}
+	}
+
+	/* Moving from onto to must not turn any of the remaining triangles around from over */
+	auto flips = [&](uint32_t from, uint32_t to) {
+		glm::dvec3 target = position(to);
+
+		for (uint32_t t : adjacency[from]) {
+			if (dead[t])
+				continue;
+
+			const unsigned int *tri = &triangles[3 * t];
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			glm::dvec3 p[3];
+			for (int k = 0; k < 3; ++k)
+				p[k] = position(tri[k]);
+
+			glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+			for (int k = 0; k < 3; ++k) {
+				if (tri[k] == from)
+					p[k] = target;
+			}
+
+			glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+			if (glm::dot(before, after) <= 0.0)
+				return true;
+		}
+
+		return false;
+	};
+
+	size_t alive = n_triangles;
+
+	while (3 * alive > target_index_count && !heap.empty()) {
+		collapse c = heap.top();
+		heap.pop();
+
+		if (removed[c.from] || removed[c.to] || c.from_version != version[c.from] || c.to_version != version[c.to])
+			continue;
+
+		if (flips(c.from, c.to))
+			continue;
+
+		removed[c.from] = true;
+		collapsed_to[c.from] = c.to;
+		quadrics[c.to] += quadrics[c.from];
+		++version[c.to];
+
+		for (uint32_t t : adjacency[c.from]) {
+			if (dead[t])
+				continue;
+
+			unsigned int *tri = &triangles[3 * t];
+			if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+				dead[t] = true;
+				--alive;
+				continue;
+			}
+
+			for (int k = 0; k < 3; ++k) {
+				if (tri[k] == c.from)
+					tri[k] = c.to;
+			}
+
+			adjacency[c.to].push_back(t);
+		}
+
+		adjacency[c.from].clear();
+
+		/* Drop the dead triangles from the survivor's list and requeue its edges */
+		auto &around = adjacency[c.to];
+		around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return dead[t]; }), around.end());
+
+		for (uint32_t t : around) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = triangles[3 * t + k];
+
+				push_collapse(v, c.to);
+				push_collapse(c.to, v);
+			}
+		}
+	}
+
+	/* The cost only bounds the error, it sums the squared distances to every merged plane.
+	 * The error is measured instead: where each vertex ended up, against its own original planes. */
+	auto final_vertex = [&](uint32_t v) {
+		while (collapsed_to[v] != v)
+			v = collapsed_to[v] = collapsed_to[collapsed_to[v]];
+
+		return v;
+	};
+
+	double max_distance = 0.0;
+	for (size_t t = 0; t < n_triangles; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = indices[3 * t + k];
+			if (!removed[v])
+				continue;
+
+			glm::dvec3 p = position(final_vertex(v));
+			max_distance = std::max(max_distance, std::abs(glm::dot(glm::dvec3{ planes[t] }, p) + planes[t].w));
+		}
+	}
+
+	error = (float)max_distance;
+
+	std::vector<unsigned int> result;
+	result.reserve(3 * alive);
+	for (size_t t = 0; t < n_triangles; ++t) {
+		if (!dead[t])
+			result.insert(result.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+	}
+
+	return result;
+}
+
+
+std::vector<mesh_lod> build_lods(const std::vector<vertex> &vertices, std::vector<unsigned int> &indices) {
+	const std::vector<unsigned int> full = indices;
+
+	std::vector<mesh_lod> lods{ mesh_lod{ 0, (uint32_t)full.size(), 0.0f } };
+
+	for (float ratio : lod_ratios) {
+		size_t target = (size_t)(full.size() / 3 * ratio) * 3;
+
+		/* Every LOD starts from the full mesh, so its error is measured against it */
+		float error;
+		std::vector<unsigned int> lod = simplify_mesh(vertices, full, target, error);
+
+		/* Not worth another level when the last one could hardly be reduced */
+		if (lod.empty() || lod.size() > lods.back().index_count * 9 / 10)
+			break;
+
+		optimize_vertex_cache(lod, vertices.size());
+
+		lods.push_back(mesh_lod{ (uint32_t)indices.size(), (uint32_t)lod.size(), std::max(error, lods.back().error) });
+		indices.insert(indices.end(), lod.begin(), lod.end());
+	}
+
+	return lods;
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+
+#include "loader.h"
+#include <vector>
+
+
+namespace loader {
+
+/* Triangle share of LOD 1 and up, relative to the full mesh */
+constexpr float lod_ratios[max_lods - 1] = { 0.5f, 0.25f, 0.1f };
+
+/* Quadric error edge collapse down to target_index_count indices, or as far as the mesh allows.
+ * Every collapse moves a vertex onto a neighbour, so the result indexes the same vertex array.
+ * Vertices on open edges never move, which keeps uv and normal seams from tearing apart.
+ * error receives the largest distance of a moved vertex from the planes of the original
+ * triangles around it, in model units. */
+std::vector<unsigned int> simplify_mesh(const std::vector<vertex> &vertices, const std::vector<unsigned int> &indices,
+	size_t target_index_count, float &error);
+
+/* Appends LODs at lod_ratios to the indices, each one cache optimized. The first entry
+ * is the full mesh. The chain stops early once the mesh won't simplify any further. */
+std::vector<mesh_lod> build_lods(const std::vector<vertex> &vertices, std::vector<unsigned int> &indices);
+
+}
@@ -0,0 +1,531 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+namespace loader {
+
+/* Less than this isn't worth a thread of its own */
+static constexpr size_t min_obj_chunk = 1 << 20;
+
+static constexpr uint32_t no_vertex = std::numeric_limits<uint32_t>::max();
+
+/* Position, uv and normal index of a face corner, no_index when the corner has none */
+using obj_corner = std::array<int32_t, 3>;
+
+/* No index parses or rebases to it, unlike -1, which a relative index one past the start gives */
+static constexpr int32_t no_index = std::numeric_limits<int32_t>::min();
+
+
+/* Everything read from one chunk of lines, faces already triangulated */
+struct obj_chunk {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<obj_corner> corners;
+
+	/* Negative indices count back from the end of this chunk's arrays. Their slots,
+	 * corner * 3 + attribute, get the element counts of the chunks before added. */
+	std::vector<size_t> relative;
+
+	bool failed = false;
+};
+
+
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+
+static bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+static bool is_digit(char c) {
+	return (unsigned char)(c - '0') < 10;
+}
+
+
+static const char *skip_space(const char *p, const char *end) {
+	while (p < end && is_space(*p))
+		++p;
+
+	return p;
+}
+
+
+/* SWAR digit conversion: the bytes are loaded little endian, so the first digit is
+ * the lowest byte, and a whole group is checked and converted with a few integer ops */
+static bool is_eight_digits(uint64_t v) {
+	return !(((v + 0x4646464646464646ull) | (v - 0x3030303030303030ull)) & 0x8080808080808080ull);
+}
+
+
+static uint32_t parse_eight_digits(uint64_t v) {
+	v -= 0x3030303030303030ull;
+	v = v * 10 + (v >> 8);
+	v = ((v & 0x000000FF000000FFull) * 0x000F424000000064ull + ((v >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull) >> 32;
+
+	return (uint32_t)v;
+}
+
+
+static bool is_four_digits(uint32_t v) {
+	return !(((v + 0x46464646u) | (v - 0x30303030u)) & 0x80808080u);
+}
+
+
+static uint32_t parse_four_digits(uint32_t v) {
+	v -= 0x30303030u;
+	v = v * 10 + (v >> 8);
+
+	return (v & 0xFF) * 100 + ((v >> 16) & 0xFF);
+}
+
+
+/* Appends the digits at p to mantissa while it holds less than 19 of them, the ones
+ * past that are only counted in dropped */
+static const char *parse_digits(const char *p, const char *end, uint64_t &mantissa, int &digits, int &dropped) {
+	while (end - p >= 8 && digits <= 11) {
+		uint64_t group;
+		std::memcpy(&group, p, sizeof(group));
+		if (!is_eight_digits(group))
+			break;
+
+		mantissa = mantissa * 100000000 + parse_eight_digits(group);
+		digits += 8;
+		p += 8;
+	}
+
+	if (end - p >= 4 && digits <= 15) {
+		uint32_t group;
+		std::memcpy(&group, p, sizeof(group));
+		if (is_four_digits(group)) {
+			mantissa = mantissa * 10000 + parse_four_digits(group);
+			digits += 4;
+			p += 4;
+		}
+	}
+
+	for (; p < end && is_digit(*p); ++p) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			++digits;
+		} else {
+			++dropped;
+		}
+	}
+
+	return p;
+}
+
+
+/* Decimal float with optional exponent. Up to 19 significant digits and exponents within
+ * 22 are exact in double, which leaves the float within an ulp of strtof. NULL when malformed. */
+static const char *parse_float(const char *p, const char *end, float &out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int dropped = 0;
+
+	const char *start = p;
+
+	/* Leading zeros aren't significant, they would only use up the 19 digits */
+	while (p < end && *p == '0')
+		++p;
+
+	p = parse_digits(p, end, mantissa, digits, dropped);
+	bool any = p != start;
+
+	int exponent = dropped;
+
+	if (p < end && *p == '.') {
+		const char *fraction = ++p;
+		int integer_digits = digits;
+		int ignored = 0;
+
+		/* Zeros before the first significant digit only move the exponent */
+		if (!digits) {
+			while (p < end && *p == '0')
+				++p;
+
+			exponent -= (int)(p - fraction);
+		}
+
+		p = parse_digits(p, end, mantissa, digits, ignored);
+		any = any || p != fraction;
+
+		exponent -= digits - integer_digits;
+	}
+
+	if (!any)
+		return NULL;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+
+		bool negative_exponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative_exponent = *p == '-';
+			++p;
+		}
+
+		if (p == end || !is_digit(*p))
+			return NULL;
+
+		int e = 0;
+		for (; p < end && is_digit(*p); ++p) {
+			if (e < 10000)
+				e = e * 10 + (*p - '0');
+		}
+
+		exponent += negative_exponent ? -e : e;
+	}
+
+	double value = (double)mantissa;
+	if (mantissa && exponent < 0)
+		value = exponent >= -22 ? value / powers_of_ten[-exponent] : value * std::pow(10.0, exponent);
+	else if (mantissa && exponent > 0)
+		value = exponent <= 22 ? value * powers_of_ten[exponent] : value * std::pow(10.0, exponent);
+
+	out = (float)(negative ? -value : value);
+
+	return p;
+}
+
+
+/* Reads up to count floats, at least required of them. Components past count,
+ * like w or vertex colors, are left unread. */
+static bool parse_floats(const char *p, const char *end, float *out, int count, int required) {
+	for (int i = 0; i < count; ++i) {
+		p = skip_space(p, end);
+		if (p == end || *p == '#')
+			return i >= required;
+
+		p = parse_float(p, end, out[i]);
+		if (!p || (p < end && !is_space(*p)))
+			return false;
+	}
+
+	return true;
+}
+
+
+/* 1 based OBJ index, or negative counting back from the last element read so far */
+static const char *parse_index(const char *p, const char *end, int64_t &out) {
+	bool negative = p < end && *p == '-';
+	if (negative)
+		++p;
+
+	if (p == end || !is_digit(*p))
+		return NULL;
+
+	int64_t value = 0;
+	for (; p < end && is_digit(*p); ++p) {
+		value = value * 10 + (*p - '0');
+		if (value > std::numeric_limits<int32_t>::max())
+			return NULL;
+	}
+
+	out = negative ? -value : value;
+
+	return p;
+}
+
+
+/* Corner of a face being read, relative has a bit set for every attribute holding a negative index */
+struct face_corner {
+	obj_corner indices;
+	uint8_t relative;
+};
+
+
+static bool parse_face(const char *p, const char *end, obj_chunk &chunk, std::vector<face_corner> &face) {
+	const size_t counts[3] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+
+	face.clear();
+
+	for (;;) {
+		p = skip_space(p, end);
+		if (p == end || *p == '#')
+			break;
+
+		face_corner corner{ { no_index, no_index, no_index }, 0 };
+
+		for (int attribute = 0; attribute < 3; ++attribute) {
+			if (attribute > 0) {
+				if (p == end || *p != '/')
+					break;
+				++p;
+
+				/* v//vn */
+				if (attribute == 1 && p < end && *p == '/')
+					continue;
+			}
+
+			int64_t index;
+			p = parse_index(p, end, index);
+			if (!p || !index)
+				return false;
+
+			if (index > 0) {
+				corner.indices[attribute] = (int32_t)(index - 1);
+			} else {
+				corner.indices[attribute] = (int32_t)((int64_t)counts[attribute] + index);
+				corner.relative |= 1 << attribute;
+			}
+		}
+
+		if (p < end && !is_space(*p))
+			return false;
+
+		face.push_back(corner);
+	}
+
+	/* Fan triangulation, with the winding flipped like aiProcess_FlipWindingOrder does */
+	for (size_t i = 1; i + 1 < face.size(); ++i) {
+		for (size_t k : { (size_t)0, i + 1, i }) {
+			for (int attribute = 0; attribute < 3; ++attribute) {
+				if (face[k].relative & (1 << attribute))
+					chunk.relative.push_back(chunk.corners.size() * 3 + attribute);
+			}
+
+			chunk.corners.push_back(face[k].indices);
+		}
+	}
+
+	return true;
+}
+
+
+static void parse_chunk(const char *p, const char *end, obj_chunk &chunk) {
+	std::vector<face_corner> face;
+
+	while (p < end) {
+		const char *line = skip_space(p, end);
+		const char *line_end = (const char *)std::memchr(line, '\n', end - line);
+		if (!line_end)
+			line_end = end;
+
+		p = line_end < end ? line_end + 1 : end;
+
+		/* Keywords are followed by a space, anything else (comments, groups, materials) is skipped */
+		size_t length = line_end - line;
+		bool ok = true;
+
+		if (length >= 2 && line[0] == 'v' && is_space(line[1])) {
+			glm::vec3 position;
+			ok = parse_floats(line + 1, line_end, &position.x, 3, 3);
+			chunk.positions.push_back(position);
+		} else if (length >= 3 && line[0] == 'v' && line[1] == 't' && is_space(line[2])) {
+			glm::vec2 uv{ 0.0f };
+			ok = parse_floats(line + 2, line_end, &uv.x, 2, 1);
+			chunk.uvs.push_back(uv);
+		} else if (length >= 3 && line[0] == 'v' && line[1] == 'n' && is_space(line[2])) {
+			glm::vec3 normal;
+			ok = parse_floats(line + 2, line_end, &normal.x, 3, 3);
+			chunk.normals.push_back(normal);
+		} else if (length >= 2 && line[0] == 'f' && is_space(line[1])) {
+			ok = parse_face(line + 1, line_end, chunk, face);
+		}
+
+		if (!ok) {
+			chunk.failed = true;
+			return;
+		}
+	}
+}
+
+
+/* For files without normals: the normalized sum of the face normals around each position,
+ * like aiProcess_GenSmoothNormals. The positions are mirrored and the winding flipped
+ * by now, so the face normals come out in the left handed space as well. */
+static void generate_normals(std::vector<vertex> &vertices, const std::vector<unsigned int> &indices,
+	const std::vector<int32_t> &position_of, size_t position_count) {
+	std::vector<glm::vec3> sums(position_count, glm::vec3{ 0.0f });
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		const glm::vec3 &a = vertices[indices[t + 0]].position;
+		const glm::vec3 &b = vertices[indices[t + 1]].position;
+		const glm::vec3 &c = vertices[indices[t + 2]].position;
+
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float length = glm::length(n);
+		if (length <= 0.0f)
+			continue;
+
+		n /= length;
+		for (int k = 0; k < 3; ++k)
+			sums[position_of[indices[t + k]]] += n;
+	}
+
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		float length = glm::length(sums[position_of[v]]);
+		vertices[v].normal = length > 0.0f ? sums[position_of[v]] / length : glm::vec3{ 0.0f };
+	}
+}
+
+
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_obj(const char *path) {
+	auto file = [&]() {
+		try {
+			return mapped_file{ path };
+		} catch (const mapping_error &) {
+			throw asset_error(path);
+		}
+	}();
+
+	const char *begin = (const char *)file.data();
+	const char *end = begin + file.size();
+
+	/* Cut right after a line break at or past the even split points */
+	const size_t n_chunks = parallel_chunks(file.size(), min_obj_chunk);
+
+	std::vector<const char *> cuts(n_chunks + 1, end);
+	cuts[0] = begin;
+	for (size_t c = 1; c < n_chunks; ++c) {
+		const char *cut = std::max(begin + file.size() * c / n_chunks, cuts[c - 1]);
+		const char *newline = (const char *)std::memchr(cut, '\n', end - cut);
+
+		cuts[c] = newline ? newline + 1 : end;
+	}
+
+	std::vector<obj_chunk> chunks(n_chunks);
+
+	parallel_for(n_chunks, 1, [&](size_t first, size_t last, size_t) {
+		for (size_t c = first; c < last; ++c)
+			parse_chunk(cuts[c], cuts[c + 1], chunks[c]);
+	});
+
+	/* Elements of each kind in the chunks before, the last entry holds the totals */
+	std::vector<std::array<int64_t, 3>> bases(n_chunks + 1, { 0, 0, 0 });
+	size_t n_corners = 0;
+
+	for (size_t c = 0; c < n_chunks; ++c) {
+		if (chunks[c].failed)
+			throw asset_error(path);
+
+		bases[c + 1] = {
+			bases[c][0] + (int64_t)chunks[c].positions.size(),
+			bases[c][1] + (int64_t)chunks[c].uvs.size(),
+			bases[c][2] + (int64_t)chunks[c].normals.size(),
+		};
+		n_corners += chunks[c].corners.size();
+	}
+
+	const std::array<int64_t, 3> totals = bases[n_chunks];
+	if (totals[0] > std::numeric_limits<int32_t>::max() || n_corners > std::numeric_limits<uint32_t>::max())
+		throw asset_error(path);
+
+	if (!totals[1]) {
+		throw std::exception("Mesh does not contain uv coordinates");
+	}
+
+	std::vector<glm::vec3> positions(totals[0]);
+	std::vector<glm::vec2> uvs(totals[1]);
+	std::vector<glm::vec3> normals(totals[2]);
+
+	/* Stitching: rebase the relative indices, check every index and mirror the attributes
+	 * into the left handed space like aiProcess_MakeLeftHanded and aiProcess_FlipUVs do */
+	parallel_for(n_chunks, 1, [&](size_t first, size_t last, size_t) {
+		for (size_t c = first; c < last; ++c) {
+			obj_chunk &chunk = chunks[c];
+
+			for (size_t slot : chunk.relative)
+				chunk.corners[slot / 3][slot % 3] += (int32_t)bases[c][slot % 3];
+
+			/* Positions are never missing, uvs and normals may be */
+			for (const obj_corner &corner : chunk.corners) {
+				for (int attribute = 0; attribute < 3; ++attribute) {
+					int32_t index = corner[attribute];
+					if ((attribute == 0 || index != no_index) && (index < 0 || index >= totals[attribute]))
+						chunk.failed = true;
+				}
+			}
+
+			for (size_t i = 0; i < chunk.positions.size(); ++i) {
+				const glm::vec3 &p = chunk.positions[i];
+				positions[bases[c][0] + i] = glm::vec3{ p.x, p.y, -p.z };
+			}
+
+			for (size_t i = 0; i < chunk.uvs.size(); ++i) {
+				const glm::vec2 &uv = chunk.uvs[i];
+				uvs[bases[c][1] + i] = glm::vec2{ uv.x, 1.0f - uv.y };
+			}
+
+			for (size_t i = 0; i < chunk.normals.size(); ++i) {
+				const glm::vec3 &n = chunk.normals[i];
+				normals[bases[c][2] + i] = glm::vec3{ n.x, n.y, -n.z };
+			}
+
+			chunk.positions = {};
+			chunk.uvs = {};
+			chunk.normals = {};
+		}
+	});
+
+	for (const obj_chunk &chunk : chunks) {
+		if (chunk.failed)
+			throw asset_error(path);
+	}
+
+	/* One vertex per distinct corner. Every position heads a list of the vertices made from it,
+	 * which rarely holds more than a handful, so lookups stay cheap without hashing. */
+	std::vector<vertex> vertices;
+	std::vector<unsigned int> indices;
+	vertices.reserve(positions.size());
+	indices.reserve(n_corners);
+
+	std::vector<uint32_t> head(positions.size(), no_vertex);
+	std::vector<uint32_t> next;
+	std::vector<std::array<int32_t, 2>> attributes;
+	std::vector<int32_t> position_of;
+	next.reserve(positions.size());
+	attributes.reserve(positions.size());
+	position_of.reserve(positions.size());
+
+	for (obj_chunk &chunk : chunks) {
+		for (const obj_corner &corner : chunk.corners) {
+			uint32_t v = head[corner[0]];
+			while (v != no_vertex && (attributes[v][0] != corner[1] || attributes[v][1] != corner[2]))
+				v = next[v];
+
+			if (v == no_vertex) {
+				v = (uint32_t)vertices.size();
+
+				vertices.push_back({
+					positions[corner[0]],
+					corner[2] != no_index ? normals[corner[2]] : glm::vec3{ 0.0f },
+					corner[1] != no_index ? uvs[corner[1]] : glm::vec2{ 0.0f },
+				});
+				attributes.push_back({ corner[1], corner[2] });
+				position_of.push_back(corner[0]);
+
+				next.push_back(head[corner[0]]);
+				head[corner[0]] = v;
+			}
+
+			indices.push_back(v);
+		}
+
+		chunk.corners = {};
+	}
+
+	if (normals.empty())
+		generate_normals(vertices, indices, position_of, positions.size());
+
+	return std::make_pair(std::move(vertices), std::move(indices));
+}
+
+}
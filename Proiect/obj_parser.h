@@ -0,0 +1,22 @@
+#pragma once
+
+
+#include "loader.h"
+#include <utility>
+#include <vector>
+
+
+namespace loader {
+
+/* Bumped whenever import_obj changes what it produces, it is part of the mesh cache key */
+constexpr uint32_t obj_parser_version = 2;
+
+/* Reads a Wavefront .obj without Assimp. The mapped file is cut at line boundaries into
+ * one chunk per hardware thread, the chunks are parsed in parallel and then stitched
+ * together. Faces are fan triangulated and every distinct position / uv / normal triple
+ * becomes one vertex. The result is what import_assimp gives with the loader's flags:
+ * left handed, flipped winding and uvs, smooth normals when the file has none. Every
+ * object and group of the file ends up in the one mesh, as with import_assimp. */
+std::pair<std::vector<vertex>, std::vector<unsigned int>> import_obj(const char *path);
+
+}
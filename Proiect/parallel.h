@@ -0,0 +1,41 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+/* Number of chunks parallel_for splits work into, at most one per hardware thread */
+inline size_t parallel_chunks(size_t count, size_t min_chunk) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return std::max<size_t>(1, std::min(threads, count / std::max<size_t>(min_chunk, 1)));
+}
+
+
+/* Calls f(begin, end, chunk) for contiguous ranges covering [0, count), each on its own thread.
+ * Ranges smaller than min_chunk aren't worth a thread, small inputs run inline. */
+template <typename F>
+void parallel_for(size_t count, size_t min_chunk, F &&f) {
+    size_t chunks = parallel_chunks(count, min_chunk);
+    if (chunks == 1) {
+        f((size_t)0, count, (size_t)0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+
+    for (size_t c = 1; c < chunks; ++c) {
+        threads.emplace_back([&f, c, count, chunks]() {
+            f(count * c / chunks, count * (c + 1) / chunks, c);
+        });
+    }
+
+    f((size_t)0, count / chunks, (size_t)0);
+
+    for (auto &thread : threads)
+        thread.join();
+}
@@ -0,0 +1,265 @@
+#include "profiler.h"
+#include <imgui.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+
+namespace {
+
+struct thread_profile {
+    profile_ring ring;
+    std::atomic<const char *> name{ nullptr };
+
+    /* Touched by the owning thread only */
+    uint32_t depth = 0;
+    uint32_t dropped_depth = 0;
+};
+
+/* Rings of every thread that ever made a marker, in the order they made their first one.
+ * They outlive their threads, a ring is never freed while end_frame may read it. */
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<thread_profile>> registry;
+
+}
+
+
+static thread_profile &this_thread_profile() {
+    thread_local thread_profile *profile = []() {
+        std::lock_guard<std::mutex> lock{ registry_mutex };
+        registry.push_back(std::make_unique<thread_profile>());
+
+        return registry.back().get();
+    }();
+
+    return *profile;
+}
+
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+void profile_begin(const char *name) {
+    thread_profile &profile = this_thread_profile();
+
+    if (profile.dropped_depth || !profile.ring.push({ name, now_ns(), true }, profile.depth + 1)) {
+        ++profile.dropped_depth;
+        return;
+    }
+
+    ++profile.depth;
+}
+
+
+void profile_end() {
+    thread_profile &profile = this_thread_profile();
+
+    if (profile.dropped_depth) {
+        --profile.dropped_depth;
+        return;
+    }
+
+    /* The begin left room for it */
+    profile.ring.push({ nullptr, now_ns(), false });
+    --profile.depth;
+}
+
+
+void profile_thread_name(const char *name) {
+    this_thread_profile().name.store(name, std::memory_order_relaxed);
+}
+
+
+profiler::profiler() : frame_start_ns_(now_ns()) {}
+
+
+void profiler::end_frame() {
+    const int64_t frame_end_ns = now_ns();
+
+    std::vector<thread_profile *> threads;
+    {
+        std::lock_guard<std::mutex> lock{ registry_mutex };
+        for (const auto &profile : registry)
+            threads.push_back(profile.get());
+    }
+
+    auto to_ms = [this](int64_t ns) { return (ns - frame_start_ns_) * 1e-6; };
+
+    frame_.clear();
+    open_.resize(threads.size());
+    threads_ = (uint32_t)threads.size();
+
+    for (uint32_t t = 0; t < threads.size(); ++t) {
+        std::vector<open_scope> &open = open_[t];
+
+        threads[t]->ring.drain([&](const profile_event &event) {
+            if (event.begin) {
+                open.push_back({ event.name, event.time_ns });
+            } else if (!open.empty()) {
+                frame_.push_back({ open.back().name, t, (uint32_t)open.size() - 1, to_ms(open.back().start_ns), to_ms(event.time_ns) });
+                open.pop_back();
+            }
+        });
+    }
+
+    frame_ms_ = to_ms(frame_end_ns);
+    frame_start_ns_ = frame_end_ns;
+
+    /* Every call of a name in the frame adds up to one sample. Keyed by the contents like
+     * history_, equal literals of different files needn't share an address. */
+    std::unordered_map<std::string_view, float> totals;
+    for (const profiled_scope &scope : frame_)
+        totals[scope.name] += (float)(scope.end_ms - scope.start_ms);
+
+    for (auto &entry : history_)
+        entry.second.spiked = false;
+
+    for (const auto &total : totals)
+        history_[std::string{ total.first }].add(total.second, spike_factor);
+}
+
+
+void scope_history::add(float sample_ms, float spike_factor) {
+    spiked = frames >= spike_warmup && sample_ms > spike_factor * avg_ms;
+
+    ms[frames % history_frames] = sample_ms;
+    ++frames;
+
+    size_t n = std::min(frames, history_frames);
+    last_ms = sample_ms;
+    min_ms = *std::min_element(ms.begin(), ms.begin() + n);
+    max_ms = *std::max_element(ms.begin(), ms.begin() + n);
+
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i)
+        sum += ms[i];
+    avg_ms = sum / n;
+}
+
+
+/* Stable color per name, so a scope keeps its color from frame to frame */
+static ImU32 scope_color(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const char *c = name; *c; ++c)
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+    return IM_COL32(70 + hash % 100, 90 + (hash >> 8) % 100, 110 + (hash >> 16) % 100, 255);
+}
+
+
+void profiler::draw_window(bool *open) {
+    if (!ImGui::Begin("Profiler", open)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Frame %.3f ms, %zu scopes", frame_ms_, frame_.size());
+    ImGui::DragFloat("spike factor", &spike_factor, 0.05f, 1.1f, 10.0f);
+
+    const float row = ImGui::GetTextLineHeightWithSpacing();
+    const ImU32 spike_color = IM_COL32(220, 50, 50, 255);
+    const ImU32 text_color = IM_COL32(255, 255, 255, 255);
+
+    /* Lanes of the threads that had scopes this frame, as deep as their deepest scope */
+    std::vector<uint32_t> lane_depth(threads_, 0);
+    std::vector<bool> lane_used(threads_, false);
+    for (const profiled_scope &scope : frame_) {
+        lane_depth[scope.thread] = std::max(lane_depth[scope.thread], scope.depth + 1);
+        lane_used[scope.thread] = true;
+    }
+
+    std::vector<float> lane_y(threads_, 0.0f);
+    float height = 0.0f;
+    for (uint32_t t = 0; t < threads_; ++t) {
+        if (!lane_used[t])
+            continue;
+
+        /* A line for the label, then the scopes */
+        lane_y[t] = height + row;
+        height += (lane_depth[t] + 1) * row;
+    }
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+    double scale = frame_ms_ > 0.0 ? width / frame_ms_ : 0.0;
+
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+
+    std::vector<thread_profile *> threads;
+    {
+        std::lock_guard<std::mutex> lock{ registry_mutex };
+        for (const auto &profile : registry)
+            threads.push_back(profile.get());
+    }
+
+    for (uint32_t t = 0; t < threads_ && t < threads.size(); ++t) {
+        if (!lane_used[t])
+            continue;
+
+        const char *name = threads[t]->name.load(std::memory_order_relaxed);
+        std::string label = name ? name : "thread " + std::to_string(t);
+        draw->AddText(ImVec2{ origin.x, origin.y + lane_y[t] - row }, text_color, label.c_str());
+    }
+
+    for (const profiled_scope &scope : frame_) {
+        float x0 = origin.x + (float)(std::max(scope.start_ms, 0.0) * scale);
+        float x1 = origin.x + (float)(std::min(scope.end_ms, frame_ms_) * scale);
+        x1 = std::max(x1, x0 + 1.0f);
+
+        ImVec2 min{ x0, origin.y + lane_y[scope.thread] + scope.depth * row };
+        ImVec2 max{ x1, min.y + row - 1.0f };
+
+        auto h = history_.find(scope.name);
+        bool spiked = h != history_.end() && h->second.spiked;
+
+        draw->AddRectFilled(min, max, spiked ? spike_color : scope_color(scope.name));
+
+        /* Names only go where they fit, the tooltip has them all */
+        draw->PushClipRect(min, max, true);
+        draw->AddText(ImVec2{ x0 + 2.0f, min.y }, text_color, scope.name);
+        draw->PopClipRect();
+
+        if (ImGui::IsMouseHoveringRect(min, max))
+            ImGui::SetTooltip("%s: %.3f ms", scope.name, scope.end_ms - scope.start_ms);
+    }
+
+    ImGui::Dummy(ImVec2{ width, height });
+
+    ImGui::Separator();
+
+    /* Rolling statistics, the most expensive scopes first */
+    std::vector<std::pair<std::string, const scope_history *>> rows;
+    for (const auto &entry : history_)
+        rows.emplace_back(entry.first, &entry.second);
+
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second->avg_ms > b.second->avg_ms; });
+
+    ImGui::Columns(5, "profiler scopes");
+    for (const char *heading : { "scope", "last ms", "min ms", "avg ms", "max ms" }) {
+        ImGui::Text("%s", heading);
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+
+    for (const auto &entry : rows) {
+        const scope_history &h = *entry.second;
+
+        if (h.spiked)
+            ImGui::TextColored(ImVec4{ 0.9f, 0.2f, 0.2f, 1.0f }, "%s", entry.first.c_str());
+        else
+            ImGui::Text("%s", entry.first.c_str());
+        ImGui::NextColumn();
+
+        for (float value : { h.last_ms, h.min_ms, h.avg_ms, h.max_ms }) {
+            ImGui::Text("%.3f", value);
+            ImGui::NextColumn();
+        }
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
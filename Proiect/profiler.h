@@ -0,0 +1,146 @@
+#pragma once
+
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/* Beginning or end of a profiled scope. name has to outlive the profiler, string literals do. */
+struct profile_event {
+    const char *name;
+    int64_t time_ns;
+    bool begin;
+};
+
+
+/* Events of one thread, written by that thread only and read by the one calling
+ * profiler::end_frame. Single producer, single consumer, so it needs no locks. */
+class profile_ring {
+public:
+    static constexpr uint32_t capacity = 4096;
+
+    /* False, dropping the event, unless reserve more slots stay free after it */
+    bool push(const profile_event &event, uint32_t reserve = 0) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) + reserve >= capacity)
+            return false;
+
+        events_[head & (capacity - 1)] = event;
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename F>
+    void drain(F &&f) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail)
+            f(events_[tail & (capacity - 1)]);
+
+        tail_.store(tail, std::memory_order_release);
+    }
+
+private:
+    std::array<profile_event, capacity> events_;
+    std::atomic<uint32_t> head_{ 0 };
+    std::atomic<uint32_t> tail_{ 0 };
+};
+
+
+/* Markers cost two clock reads and two ring writes a scope, cheap enough to stay in
+ * release builds. Every begin needs an end on the same thread. A begin is only written
+ * while the ring has room left for the ends of every open scope, so ends are never lost;
+ * scopes begun while it is full are dropped whole, nested ones included. */
+void profile_begin(const char *name);
+void profile_end();
+
+/* Label of the calling thread's lane in the flame graph */
+void profile_thread_name(const char *name);
+
+
+class profile_scope {
+public:
+    explicit profile_scope(const char *name) { profile_begin(name); }
+    ~profile_scope() { profile_end(); }
+
+    profile_scope(const profile_scope &other) = delete;
+    profile_scope &operator=(const profile_scope &other) = delete;
+};
+
+
+/* A scope that ended in the last frame, times from the frame's start */
+struct profiled_scope {
+    const char *name;
+    uint32_t thread;
+    uint32_t depth;
+    double start_ms;
+    double end_ms;
+};
+
+
+/* Times of one scope or GPU section over the last history_frames samples, one a frame.
+ * The CPU profiler and gpu_timer both keep theirs in it, so they flag spikes alike. */
+struct scope_history {
+    static constexpr size_t history_frames = 120;
+    /* Samples taken before spikes are flagged, so the average means something */
+    static constexpr size_t spike_warmup = 10;
+    static constexpr float default_spike_factor = 2.0f;
+
+    std::array<float, history_frames> ms{};
+    size_t frames = 0;
+    float last_ms = 0.0f;
+    float min_ms = 0.0f;
+    float avg_ms = 0.0f;
+    float max_ms = 0.0f;
+    /* The last sample took spike_factor times the average of the ones before it */
+    bool spiked = false;
+
+    void add(float sample_ms, float spike_factor = default_spike_factor);
+};
+
+
+/* Collects the markers of every thread once a frame and keeps the last frame for the
+ * flame graph, along with the time of each scope name over the last frames */
+class profiler {
+public:
+    static constexpr size_t history_frames = scope_history::history_frames;
+
+    profiler();
+
+    /* Drains the rings, the scopes that ended since the previous call make up the frame */
+    void end_frame();
+
+    /* Window with the last frame's flame graph, a lane per thread, and a table of the
+     * rolling min / avg / max of each scope. Scopes over spike_factor times their
+     * average are drawn red. */
+    void draw_window(bool *open);
+
+    float spike_factor = scope_history::default_spike_factor;
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    /* Scopes begun but not ended yet, per thread, carried over to the next frame */
+    struct open_scope {
+        const char *name;
+        int64_t start_ns;
+    };
+
+    int64_t frame_start_ns_;
+    double frame_ms_ = 0.0;
+
+    std::vector<std::vector<open_scope>> open_;
+    std::vector<profiled_scope> frame_;
+    uint32_t threads_ = 0;
+
+    /* Per frame totals of a scope name, every call in the frame summed */
+    std::unordered_map<std::string, scope_history> history_;
+};
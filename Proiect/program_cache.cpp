@@ -0,0 +1,146 @@
+#include "program_cache.h"
+#include "hash.h"
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+
+struct program_cache_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+};
+
+static const char program_cache_magic[4] = { 'L', 'P', 'R', 'G' };
+
+
+static std::string gl_string(GLenum name) {
+    const char *value = (const char *)glGetString(name);
+
+    return value ? value : "";
+}
+
+
+bool program_binaries_supported() {
+    if (!GLEW_ARB_get_program_binary)
+        return false;
+
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    return formats > 0;
+}
+
+
+uint64_t program_cache_key(const std::string &vertex_source, const std::string &fragment_source) {
+    uint64_t key = hash_string(vertex_source);
+    key = hash_string(fragment_source, key);
+
+    key = hash_string(gl_string(GL_VENDOR), key);
+    key = hash_string(gl_string(GL_RENDERER), key);
+    key = hash_string(gl_string(GL_VERSION), key);
+
+    uint32_t version = program_cache_version;
+    key = hash_bytes(&version, sizeof(version), key);
+
+    return key;
+}
+
+
+std::filesystem::path program_cache_path(const std::string &vertex_path, const std::string &fragment_path, uint64_t key) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+
+    std::string name = std::filesystem::path{ vertex_path }.stem().string() + "_"
+        + std::filesystem::path{ fragment_path }.stem().string() + "." + hex + ".bin";
+
+    return std::filesystem::path{ "cache" } / name;
+}
+
+
+std::optional<program_t> read_program_cache(const std::filesystem::path &path, uint64_t key) {
+    std::ifstream in{ path, std::ios::binary };
+    if (!in)
+        return std::nullopt;
+
+    program_cache_header header;
+    in.read((char *)&header, sizeof(header));
+
+    bool valid = in
+        && std::memcmp(header.magic, program_cache_magic, sizeof(program_cache_magic)) == 0
+        && header.version == program_cache_version
+        && header.key == key;
+    if (!valid) {
+        spdlog::warn("Ignoring stale or corrupt cache entry {}", path.string());
+        return std::nullopt;
+    }
+
+    std::vector<char> binary(header.size);
+    in.read(binary.data(), binary.size());
+    if (!in) {
+        spdlog::warn("Ignoring truncated cache entry {}", path.string());
+        return std::nullopt;
+    }
+
+    program_t program{ glCreateProgram() };
+    glProgramBinary(program.get(), header.format, binary.data(), (GLsizei)binary.size());
+
+    /* Drivers reject binaries after updates even when the version string stays the same */
+    int linked = GL_FALSE;
+    glGetProgramiv(program.get(), GL_LINK_STATUS, &linked);
+    if (!linked) {
+        spdlog::info("Driver rejected cached program {}", path.string());
+        return std::nullopt;
+    }
+
+    return program;
+}
+
+
+void write_program_cache(const std::filesystem::path &path, uint64_t key, uint32_t program) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    program_cache_header header{};
+    std::memcpy(header.magic, program_cache_magic, sizeof(program_cache_magic));
+    header.version = program_cache_version;
+    header.key = key;
+    header.format = format;
+    header.size = (uint32_t)length;
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    /* Written under a temporary name and renamed, like the mesh cache */
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream out{ tmp_path, std::ios::binary | std::ios::trunc };
+
+        out.write((const char *)&header, sizeof(header));
+        out.write(binary.data(), length);
+
+        if (!out) {
+            spdlog::warn("Failed to write cache entry {}", path.string());
+            std::filesystem::remove(tmp_path, ec);
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        spdlog::warn("Failed to write cache entry {}: {}", path.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+
+/* Bump whenever load_program changes what it compiles for the same sources */
+constexpr uint32_t program_cache_version = 1;
+
+/* False when the driver offers no binary formats, the cache is skipped then */
+bool program_binaries_supported();
+
+/* Identifies the final shader sources together with the driver that compiles them,
+ * a binary from another GL_RENDERER or GL_VERSION is never tried */
+uint64_t program_cache_key(const std::string &vertex_source, const std::string &fragment_source);
+
+std::filesystem::path program_cache_path(const std::string &vertex_path, const std::string &fragment_path, uint64_t key);
+
+/* Nothing when there's no entry or the driver rejected the binary */
+std::optional<program_t> read_program_cache(const std::filesystem::path &path, uint64_t key);
+
+/* The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+ * Failures are only logged, the program works anyway. */
+void write_program_cache(const std::filesystem::path &path, uint64_t key, uint32_t program);
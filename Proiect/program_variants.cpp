@@ -0,0 +1,69 @@
+#include "program_variants.h"
+#include "shader.h"
+#include <spdlog/spdlog.h>
+
+
+static const uint32_t light_buckets[] = { 16, 64, 256 };
+
+
+uint32_t shader_variant::key() const {
+    return (uint32_t)lit
+        | (uint32_t)textured << 1
+        | (uint32_t)clustered << 2
+        | (uint32_t)packed_normals << 3
+        | (uint32_t)gbuffer << 4
+        | (uint32_t)deferred << 5
+        | max_lights << 6;
+}
+
+
+std::string shader_variant::defines() const {
+    std::string result;
+
+    if (lit)
+        result += "#define LIT\n";
+    if (textured)
+        result += "#define TEXTURED\n";
+    if (clustered)
+        result += "#define CLUSTERED\n";
+    if (packed_normals)
+        result += "#define PACKED_NORMALS\n";
+    if (gbuffer)
+        result += "#define GBUFFER\n";
+    if (deferred)
+        result += "#define DEFERRED\n";
+    if (max_lights)
+        result += "#define MAX_LIGHTS " + std::to_string(max_lights) + "\n";
+
+    return result;
+}
+
+
+uint32_t light_bucket(size_t n_lights) {
+    for (uint32_t bucket : light_buckets) {
+        if (n_lights <= bucket)
+            return bucket;
+    }
+
+    return 0;
+}
+
+
+program_variants::program_variants(std::string vertex_path, std::string fragment_path, setup_fn setup)
+    : vertex_path_(std::move(vertex_path)), fragment_path_(std::move(fragment_path)), setup_(std::move(setup)) {}
+
+
+uint32_t program_variants::get(const shader_variant &variant) {
+    uint32_t key = variant.key();
+
+    auto it = programs_.find(key);
+    if (it != programs_.end())
+        return it->second.get();
+
+    spdlog::debug("Compiling shader variant {:#x}", key);
+
+    program_t program = load_program(vertex_path_, fragment_path_, variant.defines());
+    setup_(program.get(), variant);
+
+    return programs_.emplace(key, std::move(program)).first->second.get();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+
+/* Compile time options of the scene shaders, each combination is its own program */
+struct shader_variant {
+    /* Unlit variants output their color as is and carry no lighting code */
+    bool lit = true;
+    /* Samples u_tex, the instance color is used otherwise */
+    bool textured = false;
+    /* Looks up the lights in cluster_grid instead of looping over all of them */
+    bool clustered = false;
+    /* Decodes octahedron packed normals, see packed_vertex */
+    bool packed_normals = false;
+    /* Writes albedo and normal to the G-buffer instead of shading, lit only marks the surface */
+    bool gbuffer = false;
+    /* The full screen lighting pass over the G-buffer, see deferred_pass */
+    bool deferred = false;
+    /* Constant bound of the unclustered light loop, 0 when there is none, see light_bucket() */
+    uint32_t max_lights = 0;
+
+    uint32_t key() const;
+
+    /* #define lines for the options */
+    std::string defines() const;
+};
+
+
+/* Rounds a light count up to the loop bound a variant is compiled with. Few buckets
+ * keep the number of variants down, counts past the last one get an unbounded loop. */
+uint32_t light_bucket(size_t n_lights);
+
+
+/* Lazily compiled variants of one vertex and fragment shader pair */
+class program_variants {
+public:
+    /* Called with every new program in use, to bind its blocks and set its constant uniforms */
+    using setup_fn = std::function<void(uint32_t program, const shader_variant &variant)>;
+
+    program_variants(std::string vertex_path, std::string fragment_path, setup_fn setup);
+
+    program_variants(const program_variants &other) = delete;
+    program_variants &operator=(const program_variants &other) = delete;
+
+    /* Compiles the variant the first time it is asked for */
+    uint32_t get(const shader_variant &variant);
+
+    size_t size() const { return programs_.size(); }
+
+private:
+    std::string vertex_path_;
+    std::string fragment_path_;
+    setup_fn setup_;
+
+    std::unordered_map<uint32_t, program_t> programs_;
+};
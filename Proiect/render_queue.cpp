@@ -0,0 +1,270 @@
+#include "render_queue.h"
+#include "instancing.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include <algorithm>
+#include <cmath>
+
+
+/* Field widths of the sort key, the handles are truncated which only costs sort quality */
+static constexpr int depth_bits = 24;
+static constexpr int texture_bits = 12;
+static constexpr int vao_bits = 12;
+static constexpr int program_bits = 12;
+static constexpr int pass_bits = 4;
+
+static_assert(depth_bits + texture_bits + vao_bits + program_bits + pass_bits == 64, "The sort key fields must fill 64 bits");
+
+/* Profiler scopes of the passes, by render_pass */
+static const char *pass_names[] = { "depth pass", "opaque pass", "unlit pass" };
+
+
+static uint64_t field(uint64_t value, int bits, int shift) {
+    return (value & ((1ull << bits) - 1)) << shift;
+}
+
+
+void gl_state_cache::reset() {
+    program_ = unknown;
+    vao_ = unknown;
+    texture_ = unknown;
+}
+
+
+void gl_state_cache::use_program(uint32_t program) {
+    if (program_ == program) {
+        ++stats_.binds_elided;
+        return;
+    }
+
+    glUseProgram(program);
+    program_ = program;
+    ++stats_.binds_issued;
+}
+
+
+void gl_state_cache::bind_vertex_array(uint32_t vao) {
+    if (vao_ == vao) {
+        ++stats_.binds_elided;
+        return;
+    }
+
+    glBindVertexArray(vao);
+    vao_ = vao;
+    ++stats_.binds_issued;
+}
+
+
+void gl_state_cache::bind_texture(uint32_t texture) {
+    if (texture_ == texture) {
+        ++stats_.binds_elided;
+        return;
+    }
+
+    /* Texture unit 0 is active during execute() */
+    glBindTexture(GL_TEXTURE_2D, texture);
+    texture_ = texture;
+    ++stats_.binds_issued;
+}
+
+
+render_queue::render_queue(float max_depth) : max_depth_(max_depth) {
+    for (size_t i = 0; i < n_queries; ++i)
+        queries_.emplace_back(gen_query());
+}
+
+
+void render_queue::clear() {
+    draws_.clear();
+    keys_.clear();
+}
+
+
+void render_queue::submit(render_pass pass, uint32_t program, const gpu_mesh &mesh, const instance_batch &batch,
+                          uint32_t texture, float depth, const char *label) {
+    if (!batch.size())
+        return;
+
+    const uint64_t max_quantized = (1ull << depth_bits) - 1;
+    float normalized = std::clamp(depth / max_depth_, 0.0f, 1.0f);
+
+    uint64_t quantized = (uint64_t)std::lround(normalized * max_quantized);
+
+    uint64_t key = field((uint64_t)pass, pass_bits, 60);
+    if (pass == render_pass::depth) {
+        key |= field(quantized, depth_bits, 36)
+            | field(program, program_bits, 24)
+            | field(mesh.depth_vao.get(), vao_bits, 12);
+    } else {
+        key |= field(program, program_bits, 48)
+            | field(mesh.vao.get(), vao_bits, 36)
+            | field(texture, texture_bits, 24)
+            | field(quantized, depth_bits, 0);
+    }
+
+    keys_.push_back({ key, (uint32_t)draws_.size() });
+    draws_.push_back({ program, texture, &mesh, &batch, label });
+}
+
+
+void render_queue::sort() {
+    const size_t n = keys_.size();
+    if (!n)
+        return;
+
+    scratch_.resize(n);
+
+    /* LSD radix sort a byte at a time, stable so equal keys keep their submission order */
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (const auto &e : keys_)
+            ++offsets[(e.key >> shift) & 0xff];
+
+        /* All keys share this byte, the pass would not move anything */
+        if (offsets[(keys_[0].key >> shift) & 0xff] == n)
+            continue;
+
+        size_t sum = 0;
+        for (size_t &offset : offsets) {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+
+        for (const auto &e : keys_)
+            scratch_[offsets[(e.key >> shift) & 0xff]++] = e;
+
+        keys_.swap(scratch_);
+    }
+}
+
+
+void render_queue::begin_pass(render_pass pass, bool prepassed) {
+    switch (pass) {
+    case render_pass::depth:
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+        break;
+    case render_pass::opaque:
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(prepassed ? GL_FALSE : GL_TRUE);
+        glDepthFunc(prepassed ? GL_EQUAL : GL_LESS);
+        break;
+    case render_pass::unlit:
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+        break;
+    }
+}
+
+
+void render_queue::execute(gpu_timer *timer) {
+    uint64_t fragments_shaded = stats_.fragments_shaded;
+
+    stats_ = render_queue_stats{};
+    stats_.draws_submitted = keys_.size();
+
+    /* The oldest query is the one about to be reused */
+    uint32_t query = queries_[frame_++ % n_queries].get();
+    if (frame_ > n_queries) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (available) {
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+            fragments_shaded = samples;
+        }
+    }
+    stats_.fragments_shaded = fragments_shaded;
+
+    {
+        profile_scope scope{ "sort" };
+        sort();
+    }
+
+    state_.reset();
+    state_.clear_stats();
+
+    glActiveTexture(GL_TEXTURE0);
+
+    const uint64_t opaque = (uint64_t)render_pass::opaque;
+
+    bool prepassed = !keys_.empty() && (render_pass)(keys_.front().key >> 60) == render_pass::depth;
+    bool counted = false;
+    uint64_t current = ~0ull;
+
+    for (const auto &e : keys_) {
+        const draw &d = draws_[e.draw];
+
+        uint64_t pass = e.key >> 60;
+        if (pass != current) {
+            if (current == opaque)
+                glEndQuery(GL_SAMPLES_PASSED);
+
+            if (current != ~0ull) {
+                profile_end();
+                if (timer)
+                    timer->end();
+            }
+
+            current = pass;
+            profile_begin(pass_names[pass]);
+            if (timer)
+                timer->begin(pass_names[pass]);
+            begin_pass((render_pass)pass, prepassed);
+
+            if (current == opaque) {
+                glBeginQuery(GL_SAMPLES_PASSED, query);
+                counted = true;
+            }
+        }
+
+        state_.use_program(d.program);
+
+        if ((render_pass)pass == render_pass::depth) {
+            state_.bind_vertex_array(d.mesh->depth_vao.get());
+        } else {
+            state_.bind_vertex_array(d.mesh->vao.get());
+            if (d.texture)
+                state_.bind_texture(d.texture);
+        }
+
+        /* Labelled draws are a section of their own on the CPU and the GPU */
+        if (d.label) {
+            profile_scope scope{ d.label };
+            if (timer)
+                timer->begin(d.label);
+
+            d.batch->draw(*d.mesh);
+
+            if (timer)
+                timer->end();
+        } else {
+            d.batch->draw(*d.mesh);
+        }
+    }
+
+    if (current == opaque)
+        glEndQuery(GL_SAMPLES_PASSED);
+
+    if (current != ~0ull) {
+        profile_end();
+        if (timer)
+            timer->end();
+    }
+
+    /* Run the query empty rather than leave a slot of the ring without a result */
+    if (!counted) {
+        glBeginQuery(GL_SAMPLES_PASSED, query);
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+
+    begin_pass(render_pass::unlit, false);
+
+    stats_.binds_issued = state_.stats().binds_issued;
+    stats_.binds_elided = state_.stats().binds_elided;
+}
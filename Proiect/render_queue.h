@@ -0,0 +1,128 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+struct gpu_mesh;
+class instance_batch;
+class gpu_timer;
+
+
+/* Draws are executed pass by pass in this order */
+enum class render_pass : uint32_t {
+    /* Depth only prepass, drawn with the meshes' depth VAOs and color writes masked.
+     * When it has draws the opaque pass tests depth for equality without writing it,
+     * so every covered pixel is shaded once. */
+    depth,
+    opaque,
+    unlit,
+};
+
+
+struct gl_state_stats {
+    size_t binds_issued = 0;
+    size_t binds_elided = 0;
+};
+
+
+/* Remembers the bound program, VAO and unit 0 texture and skips binding them again */
+class gl_state_cache {
+public:
+    /* Forgets everything, to be called when other code may have changed the bindings */
+    void reset();
+
+    void use_program(uint32_t program);
+    void bind_vertex_array(uint32_t vao);
+    void bind_texture(uint32_t texture);
+
+    const gl_state_stats &stats() const { return stats_; }
+
+    void clear_stats() { stats_ = gl_state_stats{}; }
+
+private:
+    /* Nothing bound yet compares unequal to every handle, 0 included */
+    static constexpr uint64_t unknown = ~0ull;
+
+    uint64_t program_ = unknown;
+    uint64_t vao_ = unknown;
+    uint64_t texture_ = unknown;
+
+    gl_state_stats stats_;
+};
+
+
+struct render_queue_stats {
+    size_t draws_submitted = 0;
+    size_t binds_issued = 0;
+    size_t binds_elided = 0;
+    /* Samples that passed the depth test in the opaque pass, a couple of frames old */
+    uint64_t fragments_shaded = 0;
+};
+
+
+/* Collects the draws of a frame and executes them sorted by a 64 bit key:
+ * pass, program, VAO, texture and depth from the most significant bits down.
+ * Draws sharing state end up next to each other, and within the same state
+ * they go front to back. The depth pass has a single cheap state, so its
+ * draws are keyed by depth right after the pass and go strictly front to back. */
+class render_queue {
+public:
+    /* Depths are quantized over [0, max_depth] */
+    explicit render_queue(float max_depth);
+
+    render_queue(const render_queue &other) = delete;
+    render_queue &operator=(const render_queue &other) = delete;
+
+    void clear();
+
+    /* texture 0 draws without touching the texture binding. label names the draw
+     * in the GPU times, it has to outlive the queue. */
+    void submit(render_pass pass, uint32_t program, const gpu_mesh &mesh, const instance_batch &batch,
+                uint32_t texture, float depth, const char *label = nullptr);
+
+    /* Sorts the draws and issues them, texture binds go to unit 0. Leaves depth
+     * testing with GL_LESS and depth and color writes enabled. With a timer each
+     * pass is a GPU section, and each labelled draw a section within it. */
+    void execute(gpu_timer *timer = nullptr);
+
+    size_t size() const { return keys_.size(); }
+
+    const render_queue_stats &stats() const { return stats_; }
+
+private:
+    struct draw {
+        uint32_t program;
+        uint32_t texture;
+        const gpu_mesh *mesh;
+        const instance_batch *batch;
+        const char *label;
+    };
+
+    struct sort_entry {
+        uint64_t key;
+        uint32_t draw;
+    };
+
+    void sort();
+
+    void begin_pass(render_pass pass, bool prepassed);
+
+    /* Occlusion queries around the opaque pass, read back frames later so they never stall */
+    static constexpr size_t n_queries = 3;
+
+    float max_depth_;
+
+    std::vector<draw> draws_;
+    std::vector<sort_entry> keys_;
+    std::vector<sort_entry> scratch_;
+
+    gl_state_cache state_;
+    render_queue_stats stats_;
+
+    std::vector<query_t> queries_;
+    size_t frame_ = 0;
+};
@@ -0,0 +1,146 @@
+#include "scene_generator.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+/* Distance between neighbouring objects, a ferrari is about 4.5 units long */
+static constexpr float object_spacing = 6.0f;
+static constexpr float object_scale = 0.015f;
+/* The top of the platform */
+static constexpr float ground_y = -4.0f;
+static constexpr float light_height = 2.0f;
+static constexpr uint32_t objects_per_cluster = 64;
+
+
+/* Uniform in [0, 1), from the top 24 bits so every value is exact in a float */
+static float uniform(std::mt19937 &rng) {
+    return (rng() >> 8) * 0x1p-24f;
+}
+
+
+static float uniform(std::mt19937 &rng, float lo, float hi) {
+    return lo + (hi - lo) * uniform(rng);
+}
+
+
+/* Standard normal pair by Box-Muller, 1 - u keeps the logarithm away from 0 */
+static glm::vec2 normal_pair(std::mt19937 &rng) {
+    float u = 1.0f - uniform(rng);
+    float v = uniform(rng);
+
+    float r = std::sqrt(-2.0f * std::log(u));
+    float angle = glm::two_pi<float>() * v;
+
+    return glm::vec2{ r * std::cos(angle), r * std::sin(angle) };
+}
+
+
+std::optional<scene_layout> parse_layout(const std::string &name) {
+    if (name == "grid")
+        return scene_layout::grid;
+    if (name == "ring")
+        return scene_layout::ring;
+    if (name == "clusters")
+        return scene_layout::clusters;
+
+    return std::nullopt;
+}
+
+
+const char *layout_name(scene_layout layout) {
+    switch (layout) {
+    case scene_layout::grid:
+        return "grid";
+    case scene_layout::ring:
+        return "ring";
+    default:
+        return "clusters";
+    }
+}
+
+
+/* count points on the ground, spaced by spacing in the layout's pattern */
+static std::vector<glm::vec2> layout_points(scene_layout layout, uint32_t count, float spacing, std::mt19937 &rng) {
+    std::vector<glm::vec2> points;
+    points.reserve(count);
+
+    if (layout == scene_layout::grid) {
+        uint32_t side = (uint32_t)std::ceil(std::sqrt((double)count));
+        float half = 0.5f * (side - 1) * spacing;
+
+        for (uint32_t i = 0; i < count; ++i)
+            points.emplace_back((i % side) * spacing - half, (i / side) * spacing - half);
+    } else if (layout == scene_layout::ring) {
+        /* The first ring is as wide as the default scene's, each next one a spacing further out */
+        float radius = 20.0f;
+
+        while (points.size() < count) {
+            uint32_t on_ring = std::max(1u, (uint32_t)(glm::two_pi<float>() * radius / spacing));
+            on_ring = std::min<uint32_t>(on_ring, count - (uint32_t)points.size());
+
+            for (uint32_t i = 0; i < on_ring; ++i) {
+                float angle = glm::two_pi<float>() * i / on_ring;
+                points.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+            }
+
+            radius += spacing;
+        }
+    } else {
+        uint32_t n_clusters = std::max(1u, (count + objects_per_cluster - 1) / objects_per_cluster);
+
+        /* Centers spread over the area a grid of the same count would take */
+        float half = 0.5f * std::sqrt((float)count) * spacing;
+        float deviation = std::sqrt((float)objects_per_cluster) * spacing / 4.0f;
+
+        /* One draw a statement, argument evaluation order isn't fixed */
+        std::vector<glm::vec2> centers;
+        for (uint32_t i = 0; i < n_clusters; ++i) {
+            float x = uniform(rng, -half, half);
+            float y = uniform(rng, -half, half);
+            centers.emplace_back(x, y);
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+            points.push_back(centers[i % n_clusters] + deviation * normal_pair(rng));
+    }
+
+    return points;
+}
+
+
+stress_scene generate_scene(const stress_scene_options &options) {
+    std::mt19937 rng{ options.seed };
+
+    stress_scene scene;
+
+    std::vector<glm::vec2> object_points = layout_points(options.layout, options.objects, object_spacing, rng);
+
+    scene.objects.reserve(options.objects);
+    for (const glm::vec2 &p : object_points) {
+        float yaw = uniform(rng, 0.0f, 360.0f);
+        scene.objects.emplace_back(glm::vec3{ p.x, ground_y, p.y }, glm::vec3{ 0.0f, yaw, 0.0f }, glm::vec3{ object_scale });
+    }
+
+    /* Lights follow the same pattern over the same area as the objects */
+    float light_spacing = object_spacing * std::sqrt((float)std::max(options.objects, 1u) / std::max(options.lights, 1u));
+
+    std::vector<glm::vec2> light_points = layout_points(options.layout, options.lights, light_spacing, rng);
+
+    scene.lights.reserve(options.lights);
+    for (const glm::vec2 &p : light_points) {
+        /* Saturated colors around the hue circle, bright enough to tell apart */
+        float h = uniform(rng) * glm::two_pi<float>();
+        glm::vec3 color = 0.5f + 0.5f * glm::vec3{ std::cos(h), std::cos(h - 2.0944f), std::cos(h + 2.0944f) };
+
+        light l{ glm::vec3{ p.x, ground_y + light_height, p.y }, color };
+        l.constant = 1.0f;
+        l.linear = 0.2f;
+        l.quadratic = 0.1f;
+
+        scene.lights.push_back(l);
+    }
+
+    return scene;
+}
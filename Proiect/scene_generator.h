@@ -0,0 +1,43 @@
+#pragma once
+
+
+#include "transform.h"
+#include "light.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+enum class scene_layout {
+    /* Square grid, rows of objects side by side */
+    grid,
+    /* Concentric rings around the origin, like the ferraris of the default scene */
+    ring,
+    /* Gaussian clumps of about 64 objects around random centers */
+    clusters,
+};
+
+std::optional<scene_layout> parse_layout(const std::string &name);
+
+const char *layout_name(scene_layout layout);
+
+
+struct stress_scene_options {
+    uint32_t objects = 1000;
+    uint32_t lights = 64;
+    scene_layout layout = scene_layout::grid;
+    uint32_t seed = 1;
+};
+
+
+/* Object transforms and lights standing in for the hard coded scene of run_main_loop.
+ * The spacing stays the same at every count, so the scene grows instead of getting denser.
+ * Equal options give equal scenes on every machine: the random values are mapped from
+ * std::mt19937's output by hand, since the std distributions differ between libraries. */
+struct stress_scene {
+    std::vector<transform> objects;
+    std::vector<light> lights;
+};
+
+stress_scene generate_scene(const stress_scene_options &options);
@@ -0,0 +1,155 @@
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "scene_import.h"
+#include "weld.h"
+#include "mesh_optimize.h"
+#include <spdlog/spdlog.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <utility>
+
+
+namespace loader {
+
+static constexpr uint32_t scene_import_flags =
+	aiProcess_MakeLeftHanded |
+	aiProcess_FlipWindingOrder |
+	aiProcess_FlipUVs |
+	aiProcess_CalcTangentSpace |
+	aiProcess_GenSmoothNormals |
+	aiProcess_Triangulate |
+	aiProcess_FixInfacingNormals |
+	aiProcess_FindInvalidData |
+	aiProcess_ValidateDataStructure;
+
+
+static void append_mesh(const aiMesh *mesh, const glm::mat4 &transform, const weld_options &weld, scene_data &scene) {
+	const glm::mat3 normal_transform = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+	std::vector<vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	vertices.reserve(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+		aiVector3D pos = mesh->mVertices[i];
+		aiVector3D norm = mesh->mNormals ? mesh->mNormals[i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+		aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+
+		glm::vec3 normal = normal_transform * glm::vec3{ norm.x, norm.y, norm.z };
+		float length = glm::length(normal);
+
+		vertices.push_back({
+			glm::vec3{ transform * glm::vec4{ pos.x, pos.y, pos.z, 1.0f } },
+			length > 0.0f ? normal / length : normal,
+			glm::vec2{ uv.x, uv.y }
+		});
+	}
+
+	/* Triangulation leaves points and lines as they are, they aren't drawn */
+	indices.reserve(3 * mesh->mNumFaces);
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		const aiFace &face = mesh->mFaces[i];
+		if (face.mNumIndices != 3)
+			continue;
+
+		indices.push_back(face.mIndices[0]);
+		indices.push_back(face.mIndices[1]);
+		indices.push_back(face.mIndices[2]);
+	}
+
+	if (indices.empty())
+		return;
+
+	/* A mirroring transform turns the triangles inside out, swapping two corners turns them back */
+	if (glm::determinant(glm::mat3(transform)) < 0.0f) {
+		for (size_t i = 0; i < indices.size(); i += 3)
+			std::swap(indices[i + 1], indices[i + 2]);
+	}
+
+	weld_vertices(vertices, indices, weld);
+	optimize_mesh(vertices, indices);
+
+	scene.submeshes.push_back(submesh{
+		(uint32_t)scene.vertices.size(),
+		(uint32_t)vertices.size(),
+		(uint32_t)scene.indices.size(),
+		(uint32_t)indices.size(),
+		mesh->mMaterialIndex,
+		compute_bounds(vertices.data(), vertices.size()),
+	});
+
+	scene.vertices.insert(scene.vertices.end(), vertices.begin(), vertices.end());
+	scene.indices.insert(scene.indices.end(), indices.begin(), indices.end());
+}
+
+
+static void append_node(const aiScene *source, const aiNode *node, const glm::mat4 &parent, const weld_options &weld, scene_data &scene) {
+	/* Assimp matrices are row major */
+	const glm::mat4 transform = parent * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		append_mesh(source->mMeshes[node->mMeshes[i]], transform, weld, scene);
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		append_node(source, node->mChildren[i], transform, weld, scene);
+}
+
+
+scene_data load_scene(const char *path, const weld_options &weld) {
+	using clock = std::chrono::high_resolution_clock;
+
+	auto start = clock::now();
+
+	Assimp::Importer importer;
+
+	const aiScene *source = importer.ReadFile(path, scene_import_flags);
+	if (!source || !source->mRootNode) {
+		throw asset_error(path);
+	}
+
+	scene_data scene;
+
+	for (unsigned int i = 0; i < source->mNumMaterials; i++) {
+		const aiMaterial *material = source->mMaterials[i];
+
+		aiString name;
+		material->Get(AI_MATKEY_NAME, name);
+
+		aiColor3D diffuse{ 1.0f, 1.0f, 1.0f };
+		material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+
+		aiString texture;
+		if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0
+			|| material->GetTexture(aiTextureType_DIFFUSE, 0, &texture) != AI_SUCCESS)
+			texture.Clear();
+
+		scene.materials.push_back({ name.C_Str(), glm::vec3{ diffuse.r, diffuse.g, diffuse.b }, texture.C_Str() });
+	}
+
+	append_node(source, source->mRootNode, glm::mat4{ 1.0f }, weld, scene);
+
+	if (scene.submeshes.empty()) {
+		throw asset_error(path);
+	}
+
+	scene.bounds = compute_bounds(scene.vertices.data(), scene.vertices.size());
+
+	std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+	spdlog::info("Imported scene {} in {:.2f} ms, {} submeshes, {} materials, {} vertices, {} indices", path, elapsed.count(),
+		scene.submeshes.size(), scene.materials.size(), scene.vertices.size(), scene.indices.size());
+
+	return scene;
+}
+
+
+std::pair<std::vector<vertex>, std::vector<unsigned int>> flatten_scene(scene_data scene) {
+	for (const submesh &part : scene.submeshes) {
+		for (uint32_t i = part.first_index; i < part.first_index + part.index_count; i++)
+			scene.indices[i] += part.base_vertex;
+	}
+
+	return std::make_pair(std::move(scene.vertices), std::move(scene.indices));
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+
+#include "loader.h"
+#include <string>
+#include <vector>
+
+
+namespace loader {
+
+struct scene_material {
+	std::string name;
+	glm::vec3 diffuse_color;
+	/* As the file names it, empty without a diffuse texture */
+	std::string diffuse_texture;
+};
+
+/* Every mesh of a file, each welded and optimized on its own and appended to one vertex
+ * and one index array. Node transforms are baked into the vertices, a mesh referenced
+ * by several nodes becomes several submeshes. */
+struct scene_data {
+	std::vector<vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<submesh> submeshes;
+	std::vector<scene_material> materials;
+	mesh_bounds bounds;
+};
+
+/* Imports with the flags of load_asset except aiProcess_PreTransformVertices,
+ * so the meshes stay apart instead of being merged by material */
+scene_data load_scene(const char *path, const weld_options &weld = {});
+
+/* The submeshes as one mesh, each one's indices moved past the vertices before it */
+std::pair<std::vector<vertex>, std::vector<unsigned int>> flatten_scene(scene_data scene);
+
+}
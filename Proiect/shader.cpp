@@ -1,4 +1,7 @@
 #include "shader.h"
+#include "program_cache.h"
+#include <spdlog/spdlog.h>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 
@@ -16,9 +19,28 @@ static std::string read_file(std::filesystem::path path) {
 }
 
 
-static shader_t create_shader(const std::string &filepath, uint32_t type) {
-    std::string source = read_file(filepath);
+/* The defines go right after the #version line, which has to stay first */
+static std::string add_defines(const std::string &source, const std::string &defines) {
+    if (defines.empty())
+        return source;
 
+    size_t insert_at = 0;
+    if (source.compare(0, 8, "#version") == 0) {
+        insert_at = source.find('\n');
+        insert_at = insert_at == std::string::npos ? source.size() : insert_at + 1;
+    }
+
+    std::string result = source.substr(0, insert_at);
+    result += defines;
+    if (defines.back() != '\n')
+        result += '\n';
+    result += source.substr(insert_at);
+
+    return result;
+}
+
+
+static shader_t create_shader(const std::string &source, uint32_t type) {
     shader_t shader{glCreateShader(type)};
 
     const char *csource = source.c_str();
@@ -31,8 +53,8 @@ static shader_t create_shader(const std::string &filepath, uint32_t type) {
 }
 
 
-program_t load_program(const std::string &vertex_path, const std::string &fragment_path) {
-    auto vertex_shader = create_shader(vertex_path, GL_VERTEX_SHADER);
+static program_t compile_program(const std::string &vertex_source, const std::string &fragment_source, bool retrievable) {
+    auto vertex_shader = create_shader(vertex_source, GL_VERTEX_SHADER);
 
     int length;
     char error_log[1024];
@@ -44,7 +66,7 @@ program_t load_program(const std::string &vertex_path, const std::string &fragme
             std::string{"Failed to compile vertex shader: "} + error_log);
     }
 
-    auto fragment_shader = create_shader(fragment_path, GL_FRAGMENT_SHADER);
+    auto fragment_shader = create_shader(fragment_source, GL_FRAGMENT_SHADER);
 
     glGetShaderiv(fragment_shader.get(), GL_INFO_LOG_LENGTH, &length);
     if (length) {
@@ -57,6 +79,9 @@ program_t load_program(const std::string &vertex_path, const std::string &fragme
     glAttachShader(program.get(), vertex_shader.get());
     glAttachShader(program.get(), fragment_shader.get());
 
+    if (retrievable)
+        glProgramParameteri(program.get(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     glLinkProgram(program.get());
 
     glGetProgramiv(program.get(), GL_INFO_LOG_LENGTH, &length);
@@ -66,7 +91,53 @@ program_t load_program(const std::string &vertex_path, const std::string &fragme
             std::string{"Failed to compile fragment shader: "} + error_log);
     }
 
+    return program;
+}
+
+
+program_t load_program(const std::string &vertex_path, const std::string &fragment_path, const std::string &defines) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::string vertex_source = add_defines(read_file(vertex_path), defines);
+    std::string fragment_source = add_defines(read_file(fragment_path), defines);
+
+    bool cacheable = program_binaries_supported();
+
+    uint64_t key = 0;
+    std::filesystem::path cached_path;
+
+    if (cacheable) {
+        key = program_cache_key(vertex_source, fragment_source);
+        cached_path = program_cache_path(vertex_path, fragment_path, key);
+
+        if (auto cached = read_program_cache(cached_path, key)) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            spdlog::info("Loaded program {} from {} in {:.2f} ms (warm)", vertex_path, cached_path.string(), elapsed.count());
+
+            glUseProgram(cached->get());
+
+            return std::move(*cached);
+        }
+    }
+
+    program_t program = compile_program(vertex_source, fragment_source, cacheable);
+
+    if (cacheable)
+        write_program_cache(cached_path, key, program.get());
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    spdlog::info("Compiled program {} in {:.2f} ms (cold)", vertex_path, elapsed.count());
+
     glUseProgram(program.get());
 
     return program;
 }
+
+
+int get_location(uint32_t program, const char *uniform_name) {
+    int location = glGetUniformLocation(program, uniform_name);
+    if (location == -1)
+        spdlog::warn("Uniform {} was not found in the program", uniform_name);
+
+    return location;
+}
@@ -31,4 +31,9 @@ private:
 };
 
 
-program_t load_program(const std::string &vertex_path, const std::string &fragment_path);
+/* Compiles and links the two shaders, or loads the binary a previous run cached for the
+ * same sources and driver. defines is inserted after the #version line of both. */
+program_t load_program(const std::string &vertex_path, const std::string &fragment_path, const std::string &defines = {});
+
+
+int get_location(uint32_t program, const char *uniform_name);
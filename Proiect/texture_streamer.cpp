@@ -0,0 +1,175 @@
+#include "texture_streamer.h"
+#include "asset_pool.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+
+
+texture_streamer::texture_streamer(asset_pool &pool, size_t bytes_per_update)
+    : pool_(pool), bytes_per_update_(bytes_per_update), placeholder_(gen_texture()) {
+    const unsigned char grey[3] = { 128, 128, 128 };
+
+    glBindTexture(GL_TEXTURE_2D, placeholder_.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    ring_.reserve(ring_size);
+    for (size_t i = 0; i < ring_size; ++i)
+        ring_.push_back(slot{ buffer_t{ gen_buffer() } });
+}
+
+
+texture_streamer::~texture_streamer() {
+    for (auto &s : ring_)
+        glDeleteSync(s.fence);
+}
+
+
+size_t texture_streamer::request(std::string path, bool flip) {
+    size_t id = textures_.size();
+    textures_.emplace_back();
+
+    ++stats_.decoding;
+
+    pool_.submit([this, id, path = std::move(path), flip]() -> asset_pool::continuation {
+        std::shared_ptr<image_data> image;
+        try {
+            image = std::make_shared<image_data>(decode_image(path, flip));
+        } catch (const image_error &ex) {
+            spdlog::warn("{}", ex.what());
+        }
+
+        return [this, id, image]() {
+            --stats_.decoding;
+
+            /* A texture that failed to decode keeps the placeholder */
+            if (image)
+                decoded_.push_back({ id, image });
+        };
+    });
+
+    return id;
+}
+
+
+uint32_t texture_streamer::get(size_t id) const {
+    const entry &e = textures_[id];
+
+    return e.ready ? e.texture->get() : placeholder_.get();
+}
+
+
+void texture_streamer::update() {
+    retire();
+
+    size_t budget = bytes_per_update_;
+    bool first = true;
+
+    while (!decoded_.empty()) {
+        slot &s = ring_[next_slot_];
+        if (s.fence)
+            break;
+
+        const decoded &d = decoded_.front();
+
+        size_t size = (size_t)d.image->width * d.image->height * d.image->channels;
+        if (!first && size > budget)
+            break;
+
+        issue(s, d);
+
+        budget -= std::min(budget, size);
+        first = false;
+
+        decoded_.pop_front();
+        next_slot_ = (next_slot_ + 1) % ring_size;
+    }
+
+    stats_.queued = decoded_.size();
+}
+
+
+void texture_streamer::retire() {
+    stats_.in_flight = 0;
+
+    for (auto &s : ring_) {
+        if (!s.fence)
+            continue;
+
+        GLenum status = glClientWaitSync(s.fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync(s.fence);
+            s.fence = NULL;
+
+            textures_[s.id].ready = true;
+        } else {
+            ++stats_.in_flight;
+        }
+    }
+}
+
+
+void texture_streamer::issue(slot &s, const decoded &d) {
+    const image_data &image = *d.image;
+    size_t size = (size_t)image.width * image.height * image.channels;
+
+    /* Grey and grey-alpha images keep their one or two channels, the swizzle spreads them */
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    if (image.channels < 1 || image.channels > 4) {
+        spdlog::warn("Texture {} has {} channels, keeping the placeholder", d.id, image.channels);
+        return;
+    }
+
+    GLenum format = formats[image.channels - 1];
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo.get());
+
+    /* Orphan the previous store, the ring slot is only reused once its fence signaled */
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+    void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        spdlog::warn("Failed to map the pixel buffer for texture {}", d.id);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    std::memcpy(dst, image.pixels.get(), size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    entry &e = textures_[d.id];
+    e.texture.emplace(gen_texture());
+
+    glBindTexture(GL_TEXTURE_2D, e.texture->get());
+
+    /* stb_image rows aren't padded to 4 bytes */
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    /* Allocate with the unpack buffer unbound, a NULL pointer would read from it otherwise */
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo.get());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    if (image.channels <= 2) {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, image.channels == 2 ? GL_GREEN : GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s.id = d.id;
+
+    stats_.bytes_uploaded += size;
+}
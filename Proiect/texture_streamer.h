@@ -0,0 +1,92 @@
+#pragma once
+
+
+#include "wrappers.h"
+#include "image.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+class asset_pool;
+
+
+struct texture_streamer_stats {
+    size_t decoding = 0;
+    size_t queued = 0;
+    size_t in_flight = 0;
+    size_t bytes_uploaded = 0;
+};
+
+
+/* Streams textures in without stalling the render thread.
+ *
+ * Images are decoded on the asset pool. update() copies decoded pixels into the next
+ * free buffer of a ring of pixel unpack buffers, issues glTexSubImage2D from it and
+ * fences the upload. Until its fence signals a texture reads as a grey placeholder,
+ * so get() has to be called every frame instead of keeping the handle around. */
+class texture_streamer {
+public:
+    static constexpr size_t ring_size = 3;
+
+    /* update() copies at most this much a frame, but always at least one image */
+    static constexpr size_t default_bytes_per_update = 8 << 20;
+
+    explicit texture_streamer(asset_pool &pool, size_t bytes_per_update = default_bytes_per_update);
+    ~texture_streamer();
+
+    texture_streamer(const texture_streamer &other) = delete;
+    texture_streamer &operator=(const texture_streamer &other) = delete;
+
+    /* Starts decoding path on the pool, the returned id names the texture from now on */
+    size_t request(std::string path, bool flip);
+
+    /* The texture once its upload completed on the GPU, the placeholder before that */
+    uint32_t get(size_t id) const;
+
+    bool ready(size_t id) const { return textures_[id].ready; }
+
+    /* Retires the uploads whose fences signaled and issues new ones. Run the pool's
+     * continuations first, they hand the decoded images over. Changes the
+     * GL_TEXTURE_2D binding of the active texture unit. */
+    void update();
+
+    const texture_streamer_stats &stats() const { return stats_; }
+
+private:
+    struct entry {
+        std::optional<texture_t> texture;
+        bool ready = false;
+    };
+
+    struct decoded {
+        size_t id;
+        std::shared_ptr<image_data> image;
+    };
+
+    struct slot {
+        buffer_t pbo;
+        GLsync fence = NULL;
+        size_t id = 0;
+    };
+
+    void retire();
+    void issue(slot &s, const decoded &d);
+
+    asset_pool &pool_;
+    size_t bytes_per_update_;
+
+    texture_t placeholder_;
+
+    std::vector<entry> textures_;
+    std::deque<decoded> decoded_;
+
+    std::vector<slot> ring_;
+    size_t next_slot_ = 0;
+
+    texture_streamer_stats stats_;
+};
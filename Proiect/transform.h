@@ -0,0 +1,25 @@
+#pragma once
+
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+
+struct transform {
+    glm::vec3 position;
+    /* Euler angles in degrees, the last one turns around (0, 1, 1) */
+    glm::vec3 rotation;
+    glm::vec3 scale;
+
+    transform(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) :
+        position(position), rotation(rotation), scale(scale) {}
+
+    /* Reference path, transform_batch computes the same matrix without the multiplies */
+    glm::mat4 to_model() const {
+        return glm::translate(position)
+            * glm::rotate(glm::radians(rotation.x), glm::vec3{ 1.0f, 0.0f, 0.0f })
+            * glm::rotate(glm::radians(rotation.y), glm::vec3{ 0.0f, 1.0f, 0.0f })
+            * glm::rotate(glm::radians(rotation.z), glm::vec3{ 0.0f, 1.0f, 1.0f })
+            * glm::scale(scale);
+    }
+};
@@ -0,0 +1,274 @@
+#include "transform_batch.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+
+static constexpr size_t group_size = 4;
+
+static constexpr float degrees_to_radians = 0.017453292519943295f;
+
+/* The third rotation axis, (0, 1, 1) normalized */
+static constexpr float axis_component = 0.70710678118654752f;
+
+
+static void sincos(float x, float &s, float &c) {
+    s = std::sin(x);
+    c = std::cos(x);
+}
+
+
+#ifdef TRANSFORM_BATCH_SSE
+
+/* Four floats with the arithmetic operators, so the math below is written once for both paths */
+struct lanes {
+    __m128 v;
+
+    lanes(__m128 v) : v(v) {}
+    lanes(float f) : v(_mm_set1_ps(f)) {}
+};
+
+static lanes operator+(lanes a, lanes b) { return _mm_add_ps(a.v, b.v); }
+static lanes operator-(lanes a, lanes b) { return _mm_sub_ps(a.v, b.v); }
+static lanes operator*(lanes a, lanes b) { return _mm_mul_ps(a.v, b.v); }
+static lanes operator/(lanes a, lanes b) { return _mm_div_ps(a.v, b.v); }
+static lanes operator-(lanes a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+
+/* Cephes style: reduce by multiples of pi / 2 in three parts, evaluate both minimax
+ * polynomials on [-pi / 4, pi / 4] and pick and negate by quadrant. Good to a couple
+ * of ulps for the angles a scene holds. */
+static void sincos(lanes x, lanes &s, lanes &c) {
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(0.63661977236758134f)));
+    lanes q = _mm_cvtepi32_ps(quadrant);
+
+    lanes y = x - q * 1.5703125f;
+    y = y - q * 4.837512969970703125e-4f;
+    y = y - q * 7.54978995489188216e-8f;
+
+    lanes z = y * y;
+
+    lanes sin_y = y + y * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+    lanes cos_y = 1.0f - z * 0.5f + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+    __m128 sin_v = _mm_or_ps(_mm_and_ps(swap, cos_y.v), _mm_andnot_ps(swap, sin_y.v));
+    __m128 cos_v = _mm_or_ps(_mm_and_ps(swap, sin_y.v), _mm_andnot_ps(swap, cos_y.v));
+
+    s = _mm_xor_ps(sin_v, sin_sign);
+    c = _mm_xor_ps(cos_v, cos_sign);
+}
+
+#endif
+
+
+/* r[row][col] = Rx(a) * Ry(b) * R(0, 1, 1)(c), expanded so no product is spent on the zeros */
+template <typename T>
+static void rotation(T a, T b, T c, T r[3][3]) {
+    T sa = 0.0f, ca = 0.0f, sb = 0.0f, cb = 0.0f, sc = 0.0f, cc = 0.0f;
+    sincos(a * degrees_to_radians, sa, ca);
+    sincos(b * degrees_to_radians, sb, cb);
+    sincos(c * degrees_to_radians, sc, cc);
+
+    /* Rodrigues for the unit axis (0, k, k), k * k = 1 / 2 */
+    T skc = sc * axis_component;
+    T h = (1.0f - cc) * 0.5f;
+
+    T z[3][3] = {
+        { cc, -skc, skc },
+        { skc, cc + h, h },
+        { -skc, h, cc + h },
+    };
+
+    T sa_sb = sa * sb;
+    T sa_cb = sa * cb;
+    T ca_sb = ca * sb;
+    T ca_cb = ca * cb;
+
+    for (int j = 0; j < 3; ++j) {
+        r[0][j] = cb * z[0][j] + sb * z[2][j];
+        r[1][j] = sa_sb * z[0][j] + ca * z[1][j] - sa_cb * z[2][j];
+        r[2][j] = sa * z[1][j] - ca_sb * z[0][j] + ca_cb * z[2][j];
+    }
+}
+
+
+void transform_batch::clear() {
+    for (auto *component : { &px_, &py_, &pz_, &rx_, &ry_, &rz_, &sx_, &sy_, &sz_ })
+        component->clear();
+
+    dynamic_.clear();
+    dirty_.clear();
+    model_.clear();
+    normal_.clear();
+    mvp_.clear();
+
+    size_ = 0;
+}
+
+
+uint32_t transform_batch::add(const transform &t, bool is_static) {
+    /* Grow a whole group at a time, padding lanes hold the identity */
+    if (size_ == px_.size()) {
+        size_t padded = size_ + group_size;
+
+        for (auto *component : { &px_, &py_, &pz_, &rx_, &ry_, &rz_ })
+            component->resize(padded, 0.0f);
+        for (auto *component : { &sx_, &sy_, &sz_ })
+            component->resize(padded, 1.0f);
+
+        dynamic_.resize(padded, 0);
+        dirty_.resize(padded, 0);
+        model_.resize(padded);
+        normal_.resize(padded);
+        mvp_.resize(padded);
+    }
+
+    uint32_t i = (uint32_t)size_++;
+
+    dynamic_[i] = !is_static;
+    set(i, t);
+
+    return i;
+}
+
+
+void transform_batch::set(uint32_t i, const transform &t) {
+    px_[i] = t.position.x;
+    py_[i] = t.position.y;
+    pz_[i] = t.position.z;
+    rx_[i] = t.rotation.x;
+    ry_[i] = t.rotation.y;
+    rz_[i] = t.rotation.z;
+    sx_[i] = t.scale.x;
+    sy_[i] = t.scale.y;
+    sz_[i] = t.scale.z;
+
+    dirty_[i] = 1;
+}
+
+
+void transform_batch::update() {
+    for (size_t begin = 0; begin < size_; begin += group_size) {
+        bool stale = false;
+        for (size_t i = begin; i < begin + group_size; ++i)
+            stale |= dynamic_[i] || dirty_[i];
+
+        if (!stale)
+            continue;
+
+        compute(begin, begin + group_size);
+
+        std::memset(&dirty_[begin], 0, group_size);
+    }
+}
+
+
+void transform_batch::compute(size_t begin, size_t end) {
+#ifdef TRANSFORM_BATCH_SSE
+    for (size_t i = begin; i < end; i += group_size) {
+        lanes r[3][3] = {
+            { 0.0f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, 0.0f },
+        };
+        rotation<lanes>(_mm_loadu_ps(&rx_[i]), _mm_loadu_ps(&ry_[i]), _mm_loadu_ps(&rz_[i]), r);
+
+        lanes scale[3] = { _mm_loadu_ps(&sx_[i]), _mm_loadu_ps(&sy_[i]), _mm_loadu_ps(&sz_[i]) };
+        lanes position[3] = { _mm_loadu_ps(&px_[i]), _mm_loadu_ps(&py_[i]), _mm_loadu_ps(&pz_[i]) };
+
+        /* Every register holds one matrix element of four transforms, transposing
+         * a column's four registers gives that column of each of the four */
+        for (int col = 0; col < 3; ++col) {
+            __m128 m0 = (r[0][col] * scale[col]).v;
+            __m128 m1 = (r[1][col] * scale[col]).v;
+            __m128 m2 = (r[2][col] * scale[col]).v;
+            __m128 m3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+            _mm_storeu_ps(&model_[i + 0][col][0], m0);
+            _mm_storeu_ps(&model_[i + 1][col][0], m1);
+            _mm_storeu_ps(&model_[i + 2][col][0], m2);
+            _mm_storeu_ps(&model_[i + 3][col][0], m3);
+
+            __m128 n0 = (r[0][col] / scale[col]).v;
+            __m128 n1 = (r[1][col] / scale[col]).v;
+            __m128 n2 = (r[2][col] / scale[col]).v;
+            __m128 n3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+
+            /* glm::mat3 columns are three floats, the fourth lane is dropped */
+            float column[4];
+            _mm_storeu_ps(column, n0);
+            std::memcpy(&normal_[i + 0][col][0], column, sizeof(glm::vec3));
+            _mm_storeu_ps(column, n1);
+            std::memcpy(&normal_[i + 1][col][0], column, sizeof(glm::vec3));
+            _mm_storeu_ps(column, n2);
+            std::memcpy(&normal_[i + 2][col][0], column, sizeof(glm::vec3));
+            _mm_storeu_ps(column, n3);
+            std::memcpy(&normal_[i + 3][col][0], column, sizeof(glm::vec3));
+        }
+
+        __m128 t0 = position[0].v;
+        __m128 t1 = position[1].v;
+        __m128 t2 = position[2].v;
+        __m128 t3 = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+        _mm_storeu_ps(&model_[i + 0][3][0], t0);
+        _mm_storeu_ps(&model_[i + 1][3][0], t1);
+        _mm_storeu_ps(&model_[i + 2][3][0], t2);
+        _mm_storeu_ps(&model_[i + 3][3][0], t3);
+    }
+#else
+    for (size_t i = begin; i < end; ++i) {
+        float r[3][3];
+        rotation<float>(rx_[i], ry_[i], rz_[i], r);
+
+        float scale[3] = { sx_[i], sy_[i], sz_[i] };
+
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 0; row < 3; ++row) {
+                model_[i][col][row] = r[row][col] * scale[col];
+                normal_[i][col][row] = r[row][col] / scale[col];
+            }
+            model_[i][col][3] = 0.0f;
+        }
+
+        model_[i][3] = glm::vec4{ px_[i], py_[i], pz_[i], 1.0f };
+    }
+#endif
+}
+
+
+void transform_batch::compute_mvp(const glm::mat4 &view_proj) {
+#ifdef TRANSFORM_BATCH_SSE
+    __m128 vp[4];
+    for (int col = 0; col < 4; ++col)
+        vp[col] = _mm_loadu_ps(&view_proj[col][0]);
+
+    for (size_t i = 0; i < size_; ++i) {
+        const glm::mat4 &m = model_[i];
+
+        for (int col = 0; col < 4; ++col) {
+            __m128 result = _mm_mul_ps(vp[0], _mm_set1_ps(m[col][0]));
+            result = _mm_add_ps(result, _mm_mul_ps(vp[1], _mm_set1_ps(m[col][1])));
+            result = _mm_add_ps(result, _mm_mul_ps(vp[2], _mm_set1_ps(m[col][2])));
+            result = _mm_add_ps(result, _mm_mul_ps(vp[3], _mm_set1_ps(m[col][3])));
+
+            _mm_storeu_ps(&mvp_[i][col][0], result);
+        }
+    }
+#else
+    for (size_t i = 0; i < size_; ++i)
+        mvp_[i] = view_proj * model_[i];
+#endif
+}
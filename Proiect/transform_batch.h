@@ -0,0 +1,54 @@
+#pragma once
+
+
+#include "transform.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* Model, normal and MVP matrices of many transforms at once.
+ *
+ * The transforms are kept as separate arrays per component and four of them are
+ * computed together with SSE: sines and cosines by polynomial, the rotation
+ * composed analytically and the normal matrix taken as R * S^-1 instead of a
+ * general inverse. Static transforms are only recomputed after set() changes them. */
+class transform_batch {
+public:
+    void clear();
+
+    uint32_t add(const transform &t, bool is_static = false);
+
+    void set(uint32_t i, const transform &t);
+
+    /* Recomputes the dynamic transforms and the static ones changed since the last update */
+    void update();
+
+    /* view_proj * model for every transform, after update() */
+    void compute_mvp(const glm::mat4 &view_proj);
+
+    const glm::mat4 &model(uint32_t i) const { return model_[i]; }
+    const glm::mat3 &normal(uint32_t i) const { return normal_[i]; }
+    const glm::mat4 &mvp(uint32_t i) const { return mvp_[i]; }
+
+    size_t size() const { return size_; }
+
+private:
+    void compute(size_t begin, size_t end);
+
+    /* Component arrays, padded to whole groups of four */
+    std::vector<float> px_, py_, pz_;
+    std::vector<float> rx_, ry_, rz_;
+    std::vector<float> sx_, sy_, sz_;
+
+    /* Static transforms stay clean until set() */
+    std::vector<uint8_t> dynamic_;
+    std::vector<uint8_t> dirty_;
+
+    std::vector<glm::mat4> model_;
+    std::vector<glm::mat3> normal_;
+    std::vector<glm::mat4> mvp_;
+
+    size_t size_ = 0;
+};
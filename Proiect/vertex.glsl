@@ -1,28 +1,60 @@
 #version 330
 
 
-in vec3 v_pos;
-in vec3 v_normal;
-in vec2 v_uv_coords;
+layout(location = 0) in vec3 v_pos;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_uv_coords;
 
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+// Per instance attributes, see instance_batch
+layout(location = 3) in mat4 i_model;
+layout(location = 7) in mat3 i_normal;
+layout(location = 10) in vec3 i_color;
 
 
-uniform mat4 u_normal;
+// Per frame values, see frame_uniforms
+layout(std140) uniform frame_block {
+    mat4 u_view;
+    mat4 u_proj;
+    vec3 u_viewpos;
+    int u_n_lights;
+    vec2 u_viewport_size;
+};
+
+
+// Must match depth_vertex.glsl bit for bit, the shading pass tests depth for equality after the prepass
+invariant gl_Position;
 
 
 out vec3 normal;
 out vec3 pos;
 out vec2 uv_coords;
+out float view_depth;
+flat out vec3 instance_color;
 
 
-void main() {
-    gl_Position = u_proj * u_view * u_model * vec4(v_pos, 1.0f);
+// Packed meshes store normals octahedron encoded in v_normal.xy, see packed_vertex
+#ifdef PACKED_NORMALS
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
 
-    normal = normalize(vec3(u_normal * vec4(v_normal, 1)));
-    pos = vec3(u_model * vec4(v_pos, 1.0));
+    return n;
+}
+#endif
+
+
+void main() {
+    pos = vec3(i_model * vec4(v_pos, 1.0));
+    gl_Position = u_proj * u_view * vec4(pos, 1.0f);
+
+#ifdef PACKED_NORMALS
+    normal = normalize(i_normal * octahedral_decode(v_normal.xy));
+#else
+    normal = normalize(i_normal * v_normal);
+#endif
     uv_coords = v_uv_coords;
+    view_depth = -(u_view * vec4(pos, 1.0)).z;
+    instance_color = i_color;
 };
@@ -0,0 +1,124 @@
+#include "weld.h"
+#include "hash.h"
+#include "parallel.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+
+namespace loader {
+
+/* Integer image of a vertex, two vertices are merged when their keys are equal */
+using weld_key = std::array<int32_t, 8>;
+
+static constexpr size_t min_weld_chunk = 16384;
+
+
+static int32_t quantize(float value, float epsilon) {
+	if (epsilon <= 0.0f) {
+		int32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		return bits;
+	}
+
+	return (int32_t)std::floor(value / epsilon);
+}
+
+
+static weld_key make_key(const vertex &v, const weld_options &options) {
+	return weld_key{
+		quantize(v.position.x, options.position_epsilon),
+		quantize(v.position.y, options.position_epsilon),
+		quantize(v.position.z, options.position_epsilon),
+		quantize(v.normal.x, options.normal_epsilon),
+		quantize(v.normal.y, options.normal_epsilon),
+		quantize(v.normal.z, options.normal_epsilon),
+		quantize(v.uvs.x, options.uv_epsilon),
+		quantize(v.uvs.y, options.uv_epsilon),
+	};
+}
+
+
+struct key_hash {
+	const uint64_t *hashes;
+
+	size_t operator()(uint32_t i) const { return (size_t)hashes[i]; }
+};
+
+
+struct key_equal {
+	const weld_key *keys;
+
+	bool operator()(uint32_t a, uint32_t b) const { return keys[a] == keys[b]; }
+};
+
+
+weld_stats weld_vertices(std::vector<vertex> &vertices, std::vector<unsigned int> &indices, const weld_options &options) {
+	const size_t n = vertices.size();
+
+	weld_stats stats{ n, n };
+	if (!n)
+		return stats;
+
+	std::vector<weld_key> keys(n);
+	std::vector<uint64_t> hashes(n);
+
+	parallel_for(n, min_weld_chunk, [&](size_t begin, size_t end, size_t) {
+		for (size_t i = begin; i < end; ++i) {
+			keys[i] = make_key(vertices[i], options);
+			hashes[i] = hash_bytes(keys[i].data(), sizeof(weld_key));
+		}
+	});
+
+	/* Equal keys have equal hashes, so after splitting the vertices by hash
+	 * every partition can be deduplicated independently of the others */
+	const size_t n_partitions = parallel_chunks(n, min_weld_chunk);
+
+	std::vector<std::vector<uint32_t>> partitions(n_partitions);
+	for (auto &partition : partitions)
+		partition.reserve(n / n_partitions);
+
+	for (uint32_t i = 0; i < n; ++i)
+		partitions[(hashes[i] >> 32) % n_partitions].push_back(i);
+
+	/* First vertex with the same key, partitions are in ascending order so it is never after i */
+	std::vector<uint32_t> representative(n);
+
+	parallel_for(n_partitions, 1, [&](size_t begin, size_t end, size_t) {
+		for (size_t p = begin; p < end; ++p) {
+			std::unordered_set<uint32_t, key_hash, key_equal> seen(
+				partitions[p].size(), key_hash{ hashes.data() }, key_equal{ keys.data() });
+
+			for (uint32_t i : partitions[p])
+				representative[i] = *seen.insert(i).first;
+		}
+	});
+
+	std::vector<uint32_t> remap(n);
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < n; ++i) {
+		if (representative[i] == i) {
+			vertices[next] = vertices[i];
+			remap[i] = next++;
+		} else {
+			remap[i] = remap[representative[i]];
+		}
+	}
+
+	vertices.resize(next);
+	vertices.shrink_to_fit();
+
+	parallel_for(indices.size(), min_weld_chunk, [&](size_t begin, size_t end, size_t) {
+		for (size_t i = begin; i < end; ++i)
+			indices[i] = remap[indices[i]];
+	});
+
+	stats.vertices_after = next;
+
+	return stats;
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+
+#include "loader.h"
+#include <vector>
+
+
+namespace loader {
+
+struct weld_stats {
+	size_t vertices_before;
+	size_t vertices_after;
+
+	size_t bytes_saved() const { return (vertices_before - vertices_after) * sizeof(vertex); }
+};
+
+/* Removes duplicate vertices and rewrites the indices to point at the survivors,
+ * which keep the order of their first occurrence. */
+weld_stats weld_vertices(std::vector<vertex> &vertices, std::vector<unsigned int> &indices, const weld_options &options = {});
+
+}
@@ -69,6 +69,22 @@ public:
         glDeleteBuffers(1, &handle_);
     }
 
+    buffer_t(const buffer_t &other) = delete;
+    buffer_t &operator=(const buffer_t &other) = delete;
+
+    buffer_t(buffer_t &&other) noexcept {
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+    }
+
+    buffer_t &operator=(buffer_t &&other) noexcept {
+        glDeleteBuffers(1, &handle_);
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+
+        return *this;
+    }
+
     uint32_t get() const { return handle_; }
 
 private:
@@ -76,6 +92,22 @@ private:
 };
 
 
+inline uint32_t gen_buffer() {
+    uint32_t handle;
+    glGenBuffers(1, &handle);
+
+    return handle;
+}
+
+
+inline uint32_t gen_vertex_array() {
+    uint32_t handle;
+    glGenVertexArrays(1, &handle);
+
+    return handle;
+}
+
+
 class vertex_array_t {
 public:
     vertex_array_t(uint32_t handle) : handle_(handle) {}
@@ -83,6 +115,22 @@ public:
         glDeleteVertexArrays(1, &handle_);
     }
 
+    vertex_array_t(const vertex_array_t &other) = delete;
+    vertex_array_t &operator=(const vertex_array_t &other) = delete;
+
+    vertex_array_t(vertex_array_t &&other) noexcept {
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+    }
+
+    vertex_array_t &operator=(vertex_array_t &&other) noexcept {
+        glDeleteVertexArrays(1, &handle_);
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+
+        return *this;
+    }
+
     uint32_t get() const { return handle_; }
 
 private:
@@ -143,3 +191,87 @@ public:
 private:
     uint32_t handle_;
 };
+
+
+inline uint32_t gen_texture() {
+    uint32_t handle;
+    glGenTextures(1, &handle);
+
+    return handle;
+}
+
+
+class query_t {
+public:
+    explicit query_t(uint32_t handle) : handle_(handle) {}
+    ~query_t() {
+        glDeleteQueries(1, &handle_);
+    }
+
+    query_t(const query_t &other) = delete;
+    query_t &operator=(const query_t &other) = delete;
+
+    query_t(query_t &&other) noexcept {
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+    }
+
+    query_t &operator=(query_t &&other) noexcept {
+        glDeleteQueries(1, &handle_);
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+
+        return *this;
+    }
+
+    uint32_t get() const { return handle_; }
+
+private:
+    uint32_t handle_;
+};
+
+
+inline uint32_t gen_query() {
+    uint32_t handle;
+    glGenQueries(1, &handle);
+
+    return handle;
+}
+
+
+class framebuffer_t {
+public:
+    explicit framebuffer_t(uint32_t handle) : handle_(handle) {}
+    ~framebuffer_t() {
+        glDeleteFramebuffers(1, &handle_);
+    }
+
+    framebuffer_t(const framebuffer_t &other) = delete;
+    framebuffer_t &operator=(const framebuffer_t &other) = delete;
+
+    framebuffer_t(framebuffer_t &&other) noexcept {
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+    }
+
+    framebuffer_t &operator=(framebuffer_t &&other) noexcept {
+        glDeleteFramebuffers(1, &handle_);
+        handle_ = 0;
+        std::swap(handle_, other.handle_);
+
+        return *this;
+    }
+
+    uint32_t get() const { return handle_; }
+
+private:
+    uint32_t handle_;
+};
+
+
+inline uint32_t gen_framebuffer() {
+    uint32_t handle;
+    glGenFramebuffers(1, &handle);
+
+    return handle;
+}